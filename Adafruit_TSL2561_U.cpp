@@ -41,26 +41,273 @@
 
 #include "Adafruit_TSL2561_U.h"
 
+static_assert(sizeof(Adafruit_TSL2561_Unified) <= TSL2561_RAM_BUDGET,
+              "Adafruit_TSL2561_Unified grew past TSL2561_RAM_BUDGET");
+
+/*========================================================================*/
+/*                            LOCAL HELPERS                               */
+/*========================================================================*/
+
+#ifdef TSL2561_WITH_LUX
+/* Value returned by calculateLuxScaled() when either channel is clipped */
+#define TSL2561_LUX_SCALED_CLIPPED (0xFFFFFFFFUL)
+#endif
+
+#ifdef TSL2561_WITH_RETIMING
+/* _tsl2561LastLevel holds the light level in steps of 2^TSL2561_LEVEL_SHIFT
+   counts at 402ms and 16x, rounded up; the brightest unclipped level is
+   under 2^22 counts, so it fits in 16 bits. These are its values when no
+   level is known, or the sensor clipped. */
+#define TSL2561_LEVEL_SHIFT (6)
+#define TSL2561_LEVEL_UNKNOWN (0)
+#define TSL2561_LEVEL_CLIPPED (0xFFFF)
+
+/* Steps saturation recovery can take: 402ms to 101ms to 13ms, then 1x */
+#define TSL2561_SAT_STEPS                                                      \
+  (TSL2561_INTEGRATIONTIME_402MS - TSL2561_INTEGRATIONTIME_13MS + 1)
+
+/* Gain/integration plans (TIMING register values), finest resolution first */
+static const uint8_t resolutionPlans[] = {
+    (uint8_t)TSL2561_INTEGRATIONTIME_402MS | TSL2561_GAIN_16X,
+    (uint8_t)TSL2561_INTEGRATIONTIME_101MS | TSL2561_GAIN_16X,
+    (uint8_t)TSL2561_INTEGRATIONTIME_402MS | TSL2561_GAIN_1X,
+    (uint8_t)TSL2561_INTEGRATIONTIME_13MS | TSL2561_GAIN_16X,
+    (uint8_t)TSL2561_INTEGRATIONTIME_101MS | TSL2561_GAIN_1X,
+    (uint8_t)TSL2561_INTEGRATIONTIME_13MS | TSL2561_GAIN_1X};
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Time to wait for a conversion to complete
+    @param  time The integration time in use
+    @returns The delay in milliseconds
+*/
+/**************************************************************************/
+static uint16_t integrationDelay(tsl2561IntegrationTime_t time) {
+  switch (time) {
+  case TSL2561_INTEGRATIONTIME_13MS:
+    return TSL2561_DELAY_INTTIME_13MS; // KTOWN: Was 14ms
+  case TSL2561_INTEGRATIONTIME_101MS:
+    return TSL2561_DELAY_INTTIME_101MS; // KTOWN: Was 102ms
+  default:
+    return TSL2561_DELAY_INTTIME_402MS; // KTOWN: Was 403ms
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of counts above which a channel is considered saturated
+    @param  time The integration time in use
+    @returns The clipping threshold in ADC counts
+*/
+/**************************************************************************/
+static uint16_t clipThreshold(tsl2561IntegrationTime_t time) {
+  switch (time) {
+  case TSL2561_INTEGRATIONTIME_13MS:
+    return TSL2561_CLIPPING_13MS;
+  case TSL2561_INTEGRATIONTIME_101MS:
+    return TSL2561_CLIPPING_101MS;
+  default:
+    return TSL2561_CLIPPING_402MS;
+  }
+}
+
+#ifdef TSL2561_WITH_LUX
+/**************************************************************************/
+/*!
+    @brief  Converts lux scaled by 2^TSL2561_LUX_LUXSCALE to milli-lux
+    @param  scaled Lux scaled by 2^TSL2561_LUX_LUXSCALE
+    @returns Lux in thousandths of a lux, rounded
+*/
+/**************************************************************************/
+static uint32_t scaledToMilliLux(uint32_t scaled) {
+  /* Split so the multiply by 1000 can't overflow 32 bits */
+  uint32_t whole = scaled >> TSL2561_LUX_LUXSCALE;
+  uint32_t frac = scaled & ((1UL << TSL2561_LUX_LUXSCALE) - 1);
+  return (whole * 1000) +
+         (((frac * 1000) + (1UL << (TSL2561_LUX_LUXSCALE - 1))) >>
+          TSL2561_LUX_LUXSCALE);
+}
+#endif
+
+#ifdef TSL2561_WITH_RETIMING
+/**************************************************************************/
+/*!
+    @brief  Number of counts below which broadband data is mostly noise
+    @param  time The integration time in use
+    @returns The noise floor in ADC counts (same as the AGC low threshold)
+*/
+/**************************************************************************/
+static uint16_t noiseFloor(tsl2561IntegrationTime_t time) {
+  switch (time) {
+  case TSL2561_INTEGRATIONTIME_13MS:
+    return TSL2561_AGC_TLO_13MS;
+  case TSL2561_INTEGRATIONTIME_101MS:
+    return TSL2561_AGC_TLO_101MS;
+  default:
+    return TSL2561_AGC_TLO_402MS;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Number of counts above which AGC considers a reading too bright
+    @param  time The integration time in use
+    @returns The AGC high threshold in ADC counts
+*/
+/**************************************************************************/
+static uint16_t agcHighThreshold(tsl2561IntegrationTime_t time) {
+  switch (time) {
+  case TSL2561_INTEGRATIONTIME_13MS:
+    return TSL2561_AGC_THI_13MS;
+  case TSL2561_INTEGRATIONTIME_101MS:
+    return TSL2561_AGC_THI_101MS;
+  default:
+    return TSL2561_AGC_THI_402MS;
+  }
+}
+#endif
+
+#ifdef TSL2561_WITH_LUX
+/**************************************************************************/
+/*!
+    @brief  Channel scale factor normalising counts to 402ms at 16x gain
+    @param  time The integration time in use
+    @param  gain The gain in use
+    @returns The scale factor, fixed point with TSL2561_LUX_CHSCALE bits
+*/
+/**************************************************************************/
+static uint32_t channelScale(tsl2561IntegrationTime_t time,
+                             tsl2561Gain_t gain) {
+  uint32_t chScale;
+
+  /* Get the correct scale depending on the intergration time */
+  switch (time) {
+  case TSL2561_INTEGRATIONTIME_13MS:
+    chScale = TSL2561_LUX_CHSCALE_TINT0;
+    break;
+  case TSL2561_INTEGRATIONTIME_101MS:
+    chScale = TSL2561_LUX_CHSCALE_TINT1;
+    break;
+  default: /* No scaling ... integration time = 402ms */
+    chScale = (1 << TSL2561_LUX_CHSCALE);
+    break;
+  }
+
+  /* Scale for gain (1x or 16x) */
+  if (!gain)
+    chScale = chScale << 4;
+
+  return chScale;
+}
+#endif
+
+#ifdef TSL2561_WITH_RETIMING
+/**************************************************************************/
+/*!
+    @brief  Confidence weight of one HDR exposure, based on how far the
+            channels sit from the clipping threshold and the noise floor
+    @param  broadband The broadband reading of the exposure
+    @param  ir The IR reading of the exposure
+    @param  time The integration time the exposure was taken with
+    @returns 0 if the exposure is clipped or in the noise, otherwise the
+             smaller of the headroom and the signal above the floor
+*/
+/**************************************************************************/
+static uint32_t hdrWeight(uint16_t broadband, uint16_t ir,
+                          tsl2561IntegrationTime_t time) {
+  uint16_t clip = clipThreshold(time);
+  uint16_t floor = noiseFloor(time);
+  uint16_t peak = (broadband > ir) ? broadband : ir;
+
+  if ((peak > clip) || (broadband <= floor))
+    return 0;
+
+  uint16_t headroom = clip - peak;
+  uint16_t signal = broadband - floor;
+  return (headroom < signal) ? headroom : signal;
+}
+#endif
+
+/* Addresses probed by discover(), in order */
+#ifdef TSL2561_FIXED_ADDR
+static const uint8_t discoveryAddresses[] = {TSL2561_FIXED_ADDR};
+#else
+static const uint8_t discoveryAddresses[] = {
+    TSL2561_ADDR_LOW, TSL2561_ADDR_FLOAT, TSL2561_ADDR_HIGH};
+#endif
+
 /*========================================================================*/
 /*                            CONSTRUCTORS                                */
 /*========================================================================*/
 
+/* This build's profile; files built with other switches can't link */
+const uint8_t TSL2561_PROFILE = 1;
+
+const tsl2561Clock_t *Adafruit_TSL2561_Unified::_clock = NULL;
+uint8_t Adafruit_TSL2561_Unified::_busRetries = 0;
+uint8_t Adafruit_TSL2561_Unified::_busBackoff = 0;
+
+#ifdef TSL2561_BUS_TRACE
+tsl2561BusRecorder_t Adafruit_TSL2561_Unified::_busRecorder = NULL;
+tsl2561BusReplay_t Adafruit_TSL2561_Unified::_busReplay = NULL;
+uint32_t Adafruit_TSL2561_Unified::_busTransactions = 0;
+#endif
+
 /**************************************************************************/
 /*!
-    @brief Constructor
-    @param addr The I2C address this chip can be found on, 0x29, 0x39 or 0x49
-    @param sensorID An optional ID that will be placed in sensor events to help
-                    keep track if you have many sensors in use
+    @brief Sets up the state of a new sensor, for the inline constructor
+    @param addr The I2C address this chip can be found on
+    @param sensorID The ID placed in sensor events
 */
 /**************************************************************************/
-Adafruit_TSL2561_Unified::Adafruit_TSL2561_Unified(uint8_t addr,
-                                                   int32_t sensorID) {
+void Adafruit_TSL2561_Unified::construct(uint8_t addr, int32_t sensorID) {
+  _i2c = NULL;
+#ifdef TSL2561_BUS_LOCK
+  _busLock = NULL;
+#endif
+#ifndef TSL2561_FIXED_ADDR
   _addr = addr;
+#else
+  (void)addr;
+#endif
   _tsl2561Initialised = false;
   _tsl2561AutoGain = false;
-  _tsl2561IntegrationTime = TSL2561_INTEGRATIONTIME_13MS;
-  _tsl2561Gain = TSL2561_GAIN_1X;
+  _tsl2561AGCFired = false;
+  _tsl2561BusFault = false;
+  _tsl2561Converting = false;
+  _tsl2561I2CErrors = 0;
+  _tsl2561ConvStart = 0;
+#ifdef TSL2561_WITH_HEALTH
+  _tsl2561Recovering = false;
+  _tsl2561HealthInterval = 0;
+  _tsl2561HealthCount = 0;
+  _tsl2561Recoveries = 0;
+  _tsl2561RecoveryTime = 0;
+  _tsl2561FaultSince = 0;
+#endif
+#ifdef TSL2561_WITH_LUX
+  _tsl2561SubLux = false;
+#endif
+#ifndef TSL2561_NO_UNIFIED_SENSOR
   _tsl2561SensorID = sensorID;
+#else
+  (void)sensorID;
+#endif
+#if !defined(TSL2561_FIXED_INTEGRATIONTIME) || !defined(TSL2561_FIXED_GAIN)
+  _tsl2561Timing = (uint8_t)TSL2561_INTEGRATIONTIME_13MS | TSL2561_GAIN_1X;
+#endif
+#ifdef TSL2561_WITH_RETIMING
+  _tsl2561SatRecovery = false;
+  _tsl2561SatRetries = 0;
+  _tsl2561TimingDirty = false;
+  _tsl2561LastLevel = TSL2561_LEVEL_UNKNOWN;
+#endif
+#ifdef TSL2561_ENERGY
+  /* The TSL2561 comes out of power-on reset powered down */
+  _tsl2561Powered = false;
+  resetEnergy();
+#endif
 }
 
 /*========================================================================*/
@@ -74,11 +321,7 @@ Adafruit_TSL2561_Unified::Adafruit_TSL2561_Unified(uint8_t addr,
     @returns True if sensor is found and initialized, false otherwise.
 */
 /**************************************************************************/
-boolean Adafruit_TSL2561_Unified::begin() {
-  _i2c = &Wire;
-  _i2c->begin();
-  return init();
-}
+boolean Adafruit_TSL2561_Unified::begin() { return beginWithin(NULL); }
 
 /**************************************************************************/
 /*!
@@ -97,27 +340,111 @@ boolean Adafruit_TSL2561_Unified::begin(TwoWire *theWire) {
 /**************************************************************************/
 /*!
     @brief  Initializes I2C connection and settings.
-    Attempts to determine if the sensor is contactable, then sets up a default
-    integration time and gain. Then powers down the chip.
+    Checks the part number with probe(), the same test discover() uses but
+    read through the retry policy, then writes the integration time and
+    gain and leaves the chip powered down.
+    @returns True if sensor is found and initialized, false otherwise.
+*/
+/**************************************************************************/
+boolean Adafruit_TSL2561_Unified::init() { return initWithin(NULL); }
+
+/**************************************************************************/
+/*!
+    @brief  begin() with the default bus, its transactions and their
+            retries kept to a deadline
+    @param  deadline Time limit for the transactions and their retries, or
+                     NULL for none
+    @returns True if sensor is found and initialized, false otherwise.
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::beginWithin(const tsl2561Deadline_t *deadline) {
+  _i2c = &Wire;
+  _i2c->begin();
+  return initWithin(deadline);
+}
+
+/**************************************************************************/
+/*!
+    @brief  init(), with its transactions and their retries kept to a
+            deadline
+    @param  deadline Time limit for the transactions and their retries, or
+                     NULL for none
     @returns True if sensor is found and initialized, false otherwise.
 */
 /**************************************************************************/
-boolean Adafruit_TSL2561_Unified::init() {
-  /* Make sure we're actually connected */
-  uint8_t x = read8(TSL2561_REGISTER_ID);
-  if (x & 0x05) { // ID code for TSL2561
+bool Adafruit_TSL2561_Unified::initWithin(const tsl2561Deadline_t *deadline) {
+  /* Make sure we're actually connected to a TSL2561 */
+  if (!probe(true, deadline))
     return false;
-  }
-  _tsl2561Initialised = true;
 
-  /* Set default integration time and gain */
-  setIntegrationTime(_tsl2561IntegrationTime);
-  setGain(_tsl2561Gain);
+  /* Set the integration time and gain; this also powers the chip down */
+  _tsl2561Initialised =
+      setTiming(currentIntegrationTime(), currentGain(), deadline);
+  return _tsl2561Initialised;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Finds every TSL2561 on one or more buses and gets each one ready
+            to use. Each of TSL2561_ADDR_LOW, _FLOAT and _HIGH is probed with
+            a single ID register read, without retries, so an empty address
+            costs one NACKed transaction. Sensors found have their bus and
+            address set and are configured as by begin(). Each bus has its
+            begin() called once.
+    @param  buses Array of buses to search, in order
+    @param  busCount Number of buses in the array
+    @param  sensors Array of at least maxSensors sensors to fill, e.g.
+                    default-constructed. Sensor IDs are left as they are,
+                    and slots past the sensors found are not touched.
+    @param  maxSensors Stop after this many sensors have been found
+    @returns The number of sensors found and initialized, at the start of
+             the sensors array
+*/
+/**************************************************************************/
+uint8_t Adafruit_TSL2561_Unified::discover(TwoWire *const *buses,
+                                           uint8_t busCount,
+                                           Adafruit_TSL2561_Unified *sensors,
+                                           uint8_t maxSensors) {
+  uint8_t found = 0;
+
+  for (uint8_t b = 0; (b < busCount) && (found < maxSensors); b++) {
+    buses[b]->begin();
+    for (uint8_t i = 0;
+         (i < sizeof(discoveryAddresses)) && (found < maxSensors); i++) {
+      /* Probe a copy, so that a slot only changes when a sensor is found */
+      Adafruit_TSL2561_Unified sensor = sensors[found];
+      sensor._i2c = buses[b];
+#ifndef TSL2561_FIXED_ADDR
+      sensor._addr = discoveryAddresses[i];
+#endif
+      if (!sensor.probe())
+        continue;
+
+      /* Same as init(), less the ID read we just did */
+      sensor._tsl2561Initialised =
+          sensor.setTiming(sensor.currentIntegrationTime(),
+                           sensor.currentGain());
+      if (sensor._tsl2561Initialised)
+        sensors[found++] = sensor;
+    }
+  }
 
-  /* Note: by default, the device is in power down mode on bootup */
-  disable();
+  return found;
+}
 
-  return true;
+/**************************************************************************/
+/*!
+    @brief  Finds every TSL2561 on a single bus, see the multi-bus version
+    @param  bus The bus to search
+    @param  sensors Array of at least maxSensors sensors to fill
+    @param  maxSensors Stop after this many sensors have been found
+    @returns The number of sensors found and initialized
+*/
+/**************************************************************************/
+uint8_t Adafruit_TSL2561_Unified::discover(TwoWire *bus,
+                                           Adafruit_TSL2561_Unified *sensors,
+                                           uint8_t maxSensors) {
+  return discover(&bus, 1, sensors, maxSensors);
 }
 
 /**************************************************************************/
@@ -131,6 +458,89 @@ void Adafruit_TSL2561_Unified::enableAutoRange(bool enable) {
   _tsl2561AutoGain = enable;
 }
 
+#ifdef TSL2561_WITH_LUX
+/**************************************************************************/
+/*!
+    @brief  Takes a reading like getEvent() and keeps everything known about
+            it: raw channels, fixed point lux, ratio segment, the gain and
+            integration time used, and the saturation and AGC flags. No bus
+            traffic is added on top of the acquisition itself.
+    @param  reading Pointer to a tsl2561Reading_t we will fill
+    @returns True if the reading is valid, false if the sensor is saturated
+             or the bus failed (see getBusFault())
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::getReading(tsl2561Reading_t *reading) {
+  uint16_t broadband, ir;
+
+  getLuminosity(&broadband, &ir);
+  if (_tsl2561BusFault) {
+    memset(reading, 0, sizeof(tsl2561Reading_t));
+    return false;
+  }
+  uint32_t lux = calculateLux(broadband, ir);
+
+  tsl2561IntegrationTime_t time = currentIntegrationTime();
+  tsl2561Gain_t gain = currentGain();
+
+#ifdef TSL2561_WITH_RETIMING
+  /* Re-measure with less sensitive settings if the sensor clipped */
+  _tsl2561SatRetries = 0;
+  if ((lux == 65536) && _tsl2561SatRecovery) {
+    lux = recoverSaturation(&broadband, &ir, &time, &gain);
+  }
+#else
+  (void)lux;
+#endif
+
+  reading->broadband = broadband;
+  reading->ir = ir;
+  reading->gain = gain;
+  reading->time = time;
+  reading->agcAdjusted = _tsl2561AGCFired;
+
+  uint32_t scaled =
+      calculateLuxScaled(broadband, ir, time, gain, &reading->segment);
+  reading->saturated = (scaled == TSL2561_LUX_SCALED_CLIPPED);
+  if (reading->saturated) {
+    reading->milliLux = 65536000UL;
+    reading->uncertainty = 0xFFFFFFFFUL;
+    reading->segment = 0;
+    return false;
+  }
+
+  reading->milliLux = scaledToMilliLux(scaled);
+  reading->uncertainty = luxResolution(broadband, ir, time, gain);
+  return true;
+}
+#endif
+
+#ifdef TSL2561_WITH_RETIMING
+/**************************************************************************/
+/*!
+    @brief  Enables or disables saturation recovery in getEvent(). When
+            enabled, a clipped reading is re-measured at shorter integration
+            times (402 -> 101 -> 13ms) and then at 1x gain until it is no
+            longer clipped. The configured settings are restored afterwards.
+    @param enable Set to true to enable, False to disable
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::enableSaturationRecovery(bool enable) {
+  _tsl2561SatRecovery = enable;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of extra conversions saturation recovery spent
+            during the last call to getEvent()
+    @returns The number of conversions on top of the normal reading
+*/
+/**************************************************************************/
+uint8_t Adafruit_TSL2561_Unified::getSaturationRetries(void) {
+  return _tsl2561SatRetries;
+}
+#endif
+
 /**************************************************************************/
 /*!
     @brief      Sets the integration time for the TSL2561. Higher time means
@@ -141,20 +551,12 @@ void Adafruit_TSL2561_Unified::enableAutoRange(bool enable) {
 /**************************************************************************/
 void Adafruit_TSL2561_Unified::setIntegrationTime(
     tsl2561IntegrationTime_t time) {
-  if (!_tsl2561Initialised)
-    begin();
-
-  /* Enable the device by setting the control bit to 0x03 */
-  enable();
-
-  /* Update the timing register */
-  write8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_TIMING, time | _tsl2561Gain);
-
-  /* Update value placeholders */
-  _tsl2561IntegrationTime = time;
+  if (!_tsl2561Initialised && !begin()) {
+    _tsl2561BusFault = true;
+    return;
+  }
 
-  /* Turn the device off to save power */
-  disable();
+  setTiming(time, currentGain());
 }
 
 /**************************************************************************/
@@ -164,21 +566,12 @@ void Adafruit_TSL2561_Unified::setIntegrationTime(
 */
 /**************************************************************************/
 void Adafruit_TSL2561_Unified::setGain(tsl2561Gain_t gain) {
-  if (!_tsl2561Initialised)
-    begin();
-
-  /* Enable the device by setting the control bit to 0x03 */
-  enable();
-
-  /* Update the timing register */
-  write8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_TIMING,
-         _tsl2561IntegrationTime | gain);
-
-  /* Update value placeholders */
-  _tsl2561Gain = gain;
+  if (!_tsl2561Initialised && !begin()) {
+    _tsl2561BusFault = true;
+    return;
+  }
 
-  /* Turn the device off to save power */
-  disable();
+  setTiming(currentIntegrationTime(), gain);
 }
 
 /**************************************************************************/
@@ -189,14 +582,25 @@ void Adafruit_TSL2561_Unified::setGain(tsl2561Gain_t gain) {
                       reading from the IR+visible light diode.
     @param  ir Pointer to a uint16_t we will fill with a sensor the
                IR-only light diode.
+    @note   Both values are 0 if the bus failed; see getBusFault().
 */
 /**************************************************************************/
 void Adafruit_TSL2561_Unified::getLuminosity(uint16_t *broadband,
                                              uint16_t *ir) {
-  bool valid = false;
+  _tsl2561AGCFired = false;
+
+  /* A sensor that isn't there gets one begin() per call, and no conversion */
+  if (!_tsl2561Initialised && !begin()) {
+    _tsl2561BusFault = true;
+    *broadband = *ir = 0;
+    return;
+  }
 
-  if (!_tsl2561Initialised)
-    begin();
+#ifndef TSL2561_WITH_AGC
+  /* Auto-gain is compiled out, or the gain can't change */
+  getData(broadband, ir);
+#else
+  bool valid = false;
 
   /* If Auto gain disabled get a single reading and continue */
   if (!_tsl2561AutoGain) {
@@ -209,7 +613,7 @@ void Adafruit_TSL2561_Unified::getLuminosity(uint16_t *broadband,
   do {
     uint16_t _b, _ir;
     uint16_t _hi, _lo;
-    tsl2561IntegrationTime_t _it = _tsl2561IntegrationTime;
+    tsl2561IntegrationTime_t _it = currentIntegrationTime();
 
     /* Get the hi/low threshold for the current integration time */
     switch (_it) {
@@ -227,22 +631,31 @@ void Adafruit_TSL2561_Unified::getLuminosity(uint16_t *broadband,
       break;
     }
 
-    getData(&_b, &_ir);
+    if (!getData(&_b, &_ir)) {
+      *broadband = *ir = 0;
+      return;
+    }
 
     /* Run an auto-gain check if we haven't already done so ... */
     if (!_agcCheck) {
-      if ((_b < _lo) && (_tsl2561Gain == TSL2561_GAIN_1X)) {
+      if ((_b < _lo) && (currentGain() == TSL2561_GAIN_1X)) {
         /* Increase the gain and try again */
         setGain(TSL2561_GAIN_16X);
         /* Drop the previous conversion results */
-        getData(&_b, &_ir);
+        if (!getData(&_b, &_ir)) {
+          *broadband = *ir = 0;
+          return;
+        }
         /* Set a flag to indicate we've adjusted the gain */
         _agcCheck = true;
-      } else if ((_b > _hi) && (_tsl2561Gain == TSL2561_GAIN_16X)) {
+      } else if ((_b > _hi) && (currentGain() == TSL2561_GAIN_16X)) {
         /* Drop gain to 1x and try again */
         setGain(TSL2561_GAIN_1X);
         /* Drop the previous conversion results */
-        getData(&_b, &_ir);
+        if (!getData(&_b, &_ir)) {
+          *broadband = *ir = 0;
+          return;
+        }
         /* Set a flag to indicate we've adjusted the gain */
         _agcCheck = true;
       } else {
@@ -261,198 +674,366 @@ void Adafruit_TSL2561_Unified::getLuminosity(uint16_t *broadband,
       valid = true;
     }
   } while (!valid);
+
+  _tsl2561AGCFired = _agcCheck;
+#endif
 }
 
 /**************************************************************************/
 /*!
-    Enables the device
+    Enables the device, writing any timing change left pending by
+    planTiming() straight after it, or in the same transaction with
+    TSL2561_FOLD_TIMING
+    @param  deadline Time limit for the write and its retries, or NULL for
+                     none
+    @returns True if the device acknowledged the write(s)
 */
 /**************************************************************************/
-void Adafruit_TSL2561_Unified::enable(void) {
+bool Adafruit_TSL2561_Unified::enable(const tsl2561Deadline_t *deadline) {
+#ifdef TSL2561_WITH_RETIMING
+  if (_tsl2561TimingDirty) {
+#ifdef TSL2561_FOLD_TIMING
+    /* The datasheet's SMB Write Word protocol (WORD bit in the command
+       register) stores the low byte in the addressed register and the high
+       byte in the next one, as it does for the 16-bit threshold registers.
+       Addressing CONTROL (0x0) thus fills TIMING (0x1) too, in one
+       transaction. Only checked against the simulator so far. */
+    if (!write16(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT |
+                     TSL2561_REGISTER_CONTROL,
+                 ((uint16_t)_tsl2561Timing << 8) | TSL2561_CONTROL_POWERON,
+                 deadline))
+      return false;
+#else
+    /* Power up, then write TIMING, as setTiming() has always done */
+    if (!write8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL,
+                TSL2561_CONTROL_POWERON, deadline) ||
+        !write8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_TIMING, _tsl2561Timing,
+                deadline))
+      return false;
+#endif
+    _tsl2561TimingDirty = false;
+    return true;
+  }
+#endif
+
   /* Enable the device by setting the control bit to 0x03 */
-  write8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL,
-         TSL2561_CONTROL_POWERON);
+  return write8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL,
+                TSL2561_CONTROL_POWERON, deadline);
 }
 
 /**************************************************************************/
 /*!
     Disables the device (putting it in lower power sleep mode)
+    @param  deadline Time limit for the write and its retries, or NULL for
+                     none
+    @returns True if the device acknowledged the write
 */
 /**************************************************************************/
-void Adafruit_TSL2561_Unified::disable(void) {
+bool Adafruit_TSL2561_Unified::disable(const tsl2561Deadline_t *deadline) {
   /* Turn the device off to save power */
-  write8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL,
-         TSL2561_CONTROL_POWEROFF);
+  return write8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL,
+                TSL2561_CONTROL_POWEROFF, deadline);
 }
 
 /**************************************************************************/
 /*!
-    Private function to read luminosity on both channels
+    Private function to abandon the conversion started by powerUp(): the
+    sensor is powered down and nothing is read
+    @param  deadline Time limit for the transaction and its retries, or
+                     NULL for none
 */
 /**************************************************************************/
-void Adafruit_TSL2561_Unified::getData(uint16_t *broadband, uint16_t *ir) {
-  /* Enable the device by setting the control bit to 0x03 */
-  enable();
+void Adafruit_TSL2561_Unified::stopConversion(
+    const tsl2561Deadline_t *deadline) {
+  _tsl2561Converting = false;
+  disable(deadline);
+}
 
-  /* Wait x ms for ADC to complete */
-  switch (_tsl2561IntegrationTime) {
-  case TSL2561_INTEGRATIONTIME_13MS:
-    delay(TSL2561_DELAY_INTTIME_13MS); // KTOWN: Was 14ms
-    break;
-  case TSL2561_INTEGRATIONTIME_101MS:
-    delay(TSL2561_DELAY_INTTIME_101MS); // KTOWN: Was 102ms
-    break;
-  default:
-    delay(TSL2561_DELAY_INTTIME_402MS); // KTOWN: Was 403ms
-    break;
+/**************************************************************************/
+/*!
+    Private function to read luminosity on both channels, on a sensor the
+    caller has already initialised
+    @returns True if the conversion was started and both channels read,
+             false (with both values 0) on a bus error
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::getData(uint16_t *broadband, uint16_t *ir) {
+  if (!powerUp()) {
+    *broadband = 0;
+    *ir = 0;
+    return false;
   }
-
-  /* Reads a two byte value from channel 0 (visible + infrared) */
-  *broadband = read16(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT |
-                      TSL2561_REGISTER_CHAN0_LOW);
-
-  /* Reads a two byte value from channel 1 (infrared) */
-  *ir = read16(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT |
-               TSL2561_REGISTER_CHAN1_LOW);
-
-  /* Turn the device off to save power */
-  disable();
+  return readConversion(broadband, ir);
 }
 
 /**************************************************************************/
 /*!
-    @brief  Converts the raw sensor values to the standard SI lux equivalent.
-    @param  broadband The 16-bit sensor reading from the IR+visible light diode.
-    @param  ir The 16-bit sensor reading from the IR-only light diode.
-    @returns The integer Lux value we calcuated.
-             Returns 0 if the sensor is saturated and the values are
-             unreliable, or 65536 if the sensor is saturated.
+    @brief  Powers the sensor up to start a conversion at the current gain
+            and integration time, and returns straight away. The sensor
+            stays powered until readConversion() is called. Auto-gain and
+            saturation recovery don't apply.
+    @returns True if the conversion was started, false on a bus error
 */
 /**************************************************************************/
+bool Adafruit_TSL2561_Unified::startConversion(void) {
+  if (!_tsl2561Initialised && !begin()) {
+    _tsl2561BusFault = true;
+    return false;
+  }
+  return powerUp();
+}
+
 /**************************************************************************/
 /*!
-
-    Returns
+    @brief  Runs a health check if one is due and powers the sensor up for
+            a conversion, on a sensor the caller has already initialised
+    @param  deadline Time limit for the transactions and their retries, or
+                     NULL for none
+    @returns True if the conversion was started, false on a bus error
 */
 /**************************************************************************/
-uint32_t Adafruit_TSL2561_Unified::calculateLux(uint16_t broadband,
-                                                uint16_t ir) {
-  unsigned long chScale;
-  unsigned long channel1;
-  unsigned long channel0;
-
-  /* Make sure the sensor isn't saturated! */
-  uint16_t clipThreshold;
-  switch (_tsl2561IntegrationTime) {
-  case TSL2561_INTEGRATIONTIME_13MS:
-    clipThreshold = TSL2561_CLIPPING_13MS;
-    break;
-  case TSL2561_INTEGRATIONTIME_101MS:
-    clipThreshold = TSL2561_CLIPPING_101MS;
-    break;
-  default:
-    clipThreshold = TSL2561_CLIPPING_402MS;
-    break;
+bool Adafruit_TSL2561_Unified::powerUp(const tsl2561Deadline_t *deadline) {
+#ifdef TSL2561_WITH_HEALTH
+  /* Check for a reset every few conversions, and before every one until
+     a fault has cleared */
+  bool checkDue = _tsl2561Recovering;
+  if (_tsl2561HealthInterval &&
+      (++_tsl2561HealthCount >= _tsl2561HealthInterval)) {
+    checkDue = true;
+  }
+  if (checkDue) {
+    _tsl2561HealthCount = 0;
+    if (!checkHealthWithin(deadline)) {
+      _tsl2561BusFault = true;
+      return false;
+    }
   }
+#endif
 
-  /* Return 65536 lux if the sensor is saturated */
-  if ((broadband > clipThreshold) || (ir > clipThreshold)) {
-    return 65536;
+  /* Enable the device by setting the control bit to 0x03 */
+  if (!enable(deadline)) {
+    _tsl2561BusFault = true;
+#ifdef TSL2561_WITH_HEALTH
+    noteFault();
+#endif
+    return false;
   }
 
-  /* Get the correct scale depending on the intergration time */
-  switch (_tsl2561IntegrationTime) {
-  case TSL2561_INTEGRATIONTIME_13MS:
-    chScale = TSL2561_LUX_CHSCALE_TINT0;
-    break;
-  case TSL2561_INTEGRATIONTIME_101MS:
-    chScale = TSL2561_LUX_CHSCALE_TINT1;
-    break;
-  default: /* No scaling ... integration time = 402ms */
-    chScale = (1 << TSL2561_LUX_CHSCALE);
-    break;
-  }
+  _tsl2561ConvStart = clockMillis();
+  _tsl2561Converting = true;
+  return true;
+}
 
-  /* Scale for gain (1x or 16x) */
-  if (!_tsl2561Gain)
-    chScale = chScale << 4;
+/**************************************************************************/
+/*!
+    @brief  Gets how long the conversion started by startConversion() still
+            needs
+    @returns The time left in milliseconds, 0 if it is done or none was
+             started
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Unified::getConversionTimeLeft(void) {
+  if (!_tsl2561Converting)
+    return 0;
 
-  /* Scale the channel values */
-  channel0 = (broadband * chScale) >> TSL2561_LUX_CHSCALE;
-  channel1 = (ir * chScale) >> TSL2561_LUX_CHSCALE;
+  uint32_t elapsed = clockMillis() - _tsl2561ConvStart;
+  uint32_t needed = integrationDelay(currentIntegrationTime());
+  return (elapsed < needed) ? needed - elapsed : 0;
+}
 
-  /* Find the ratio of the channel values (Channel1/Channel0) */
-  unsigned long ratio1 = 0;
-  if (channel0 != 0)
-    ratio1 = (channel1 << (TSL2561_LUX_RATIOSCALE + 1)) / channel0;
+/**************************************************************************/
+/*!
+    @brief  Reads both channels of the conversion started by
+            startConversion(), waiting for it to finish if needed, and
+            powers the sensor down
+    @param  broadband Pointer to a uint16_t we will fill with a sensor
+                      reading from the IR+visible light diode.
+    @param  ir Pointer to a uint16_t we will fill with a sensor the
+               IR-only light diode.
+    @returns True if both channels were read, false (with both values 0)
+             on a bus error or if no conversion was started
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::readConversion(uint16_t *broadband,
+                                              uint16_t *ir) {
+  return readConversionWithin(broadband, ir, NULL);
+}
 
-  /* round the ratio value */
-  unsigned long ratio = (ratio1 + 1) >> 1;
+/**************************************************************************/
+/*!
+    @brief  readConversion(), with its transactions and their retries kept
+            to a deadline
+    @param  broadband Pointer to a uint16_t we will fill with a sensor
+                      reading from the IR+visible light diode.
+    @param  ir Pointer to a uint16_t we will fill with a sensor the
+               IR-only light diode.
+    @param  deadline Time limit for the transactions and their retries, or
+                     NULL for none
+    @returns True if both channels were read, false (with both values 0)
+             on a bus error or if no conversion was started
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::readConversionWithin(
+    uint16_t *broadband, uint16_t *ir, const tsl2561Deadline_t *deadline) {
+  if (!_tsl2561Converting) {
+    *broadband = 0;
+    *ir = 0;
+    return false;
+  }
 
-  unsigned int b, m;
+  /* Wait x ms for ADC to complete */
+  clockDelay(getConversionTimeLeft());
+  _tsl2561Converting = false;
+
+  /* Reads a two byte value from channel 0 (visible + infrared) */
+  bool ok = read16(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT |
+                       TSL2561_REGISTER_CHAN0_LOW,
+                   broadband, deadline);
+
+  /* Reads a two byte value from channel 1 (infrared) */
+  ok &= read16(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT |
+                   TSL2561_REGISTER_CHAN1_LOW,
+               ir, deadline);
 
-#ifdef TSL2561_PACKAGE_CS
-  if ((ratio >= 0) && (ratio <= TSL2561_LUX_K1C)) {
-    b = TSL2561_LUX_B1C;
-    m = TSL2561_LUX_M1C;
-  } else if (ratio <= TSL2561_LUX_K2C) {
-    b = TSL2561_LUX_B2C;
-    m = TSL2561_LUX_M2C;
-  } else if (ratio <= TSL2561_LUX_K3C) {
-    b = TSL2561_LUX_B3C;
-    m = TSL2561_LUX_M3C;
-  } else if (ratio <= TSL2561_LUX_K4C) {
-    b = TSL2561_LUX_B4C;
-    m = TSL2561_LUX_M4C;
-  } else if (ratio <= TSL2561_LUX_K5C) {
-    b = TSL2561_LUX_B5C;
-    m = TSL2561_LUX_M5C;
-  } else if (ratio <= TSL2561_LUX_K6C) {
-    b = TSL2561_LUX_B6C;
-    m = TSL2561_LUX_M6C;
-  } else if (ratio <= TSL2561_LUX_K7C) {
-    b = TSL2561_LUX_B7C;
-    m = TSL2561_LUX_M7C;
-  } else if (ratio > TSL2561_LUX_K8C) {
-    b = TSL2561_LUX_B8C;
-    m = TSL2561_LUX_M8C;
+  /* Turn the device off to save power */
+  disable(deadline);
+
+  _tsl2561BusFault = !ok;
+  if (!ok) {
+    *broadband = 0;
+    *ir = 0;
+#ifdef TSL2561_WITH_HEALTH
+    noteFault();
+#endif
+    return false;
   }
-#else
-  if ((ratio >= 0) && (ratio <= TSL2561_LUX_K1T)) {
-    b = TSL2561_LUX_B1T;
-    m = TSL2561_LUX_M1T;
-  } else if (ratio <= TSL2561_LUX_K2T) {
-    b = TSL2561_LUX_B2T;
-    m = TSL2561_LUX_M2T;
-  } else if (ratio <= TSL2561_LUX_K3T) {
-    b = TSL2561_LUX_B3T;
-    m = TSL2561_LUX_M3T;
-  } else if (ratio <= TSL2561_LUX_K4T) {
-    b = TSL2561_LUX_B4T;
-    m = TSL2561_LUX_M4T;
-  } else if (ratio <= TSL2561_LUX_K5T) {
-    b = TSL2561_LUX_B5T;
-    m = TSL2561_LUX_M5T;
-  } else if (ratio <= TSL2561_LUX_K6T) {
-    b = TSL2561_LUX_B6T;
-    m = TSL2561_LUX_M6T;
-  } else if (ratio <= TSL2561_LUX_K7T) {
-    b = TSL2561_LUX_B7T;
-    m = TSL2561_LUX_M7T;
-  } else if (ratio > TSL2561_LUX_K8T) {
-    b = TSL2561_LUX_B8T;
-    m = TSL2561_LUX_M8T;
+
+#ifdef TSL2561_WITH_RETIMING
+  /* Remember the light level, normalised to 402ms at 16x, for planning */
+  if (*broadband > clipThreshold(currentIntegrationTime())) {
+    _tsl2561LastLevel = TSL2561_LEVEL_CLIPPED;
+  } else {
+    uint32_t level =
+        (*broadband * channelScale(currentIntegrationTime(), currentGain())) >>
+        TSL2561_LUX_CHSCALE;
+    _tsl2561LastLevel = (uint16_t)((level + (1 << TSL2561_LEVEL_SHIFT) - 1) >>
+                                   TSL2561_LEVEL_SHIFT);
   }
 #endif
 
-  unsigned long temp;
-  channel0 = channel0 * b;
-  channel1 = channel1 * m;
+  return true;
+}
 
-  temp = 0;
-  /* Do not allow negative lux value */
-  if (channel0 > channel1)
-    temp = channel0 - channel1;
+#ifdef TSL2561_WITH_COROUTINES
+/**************************************************************************/
+/*!
+    @brief  Reads both channels without blocking, from a C++20 coroutine:
+            `ok = co_await tsl.readAsync(&scheduler, &broadband, &ir);`
+            The coroutine is suspended during the integration and resumed
+            by the scheduler. Auto-gain and saturation recovery don't apply.
+    @param  scheduler Resumes the coroutine once the conversion is done
+    @param  broadband Pointer to a uint16_t we will fill with a sensor
+                      reading from the IR+visible light diode.
+    @param  ir Pointer to a uint16_t we will fill with a sensor the
+               IR-only light diode.
+    @returns An awaitable giving true if both channels were read
+*/
+/**************************************************************************/
+Adafruit_TSL2561_ReadAwaiter
+Adafruit_TSL2561_Unified::readAsync(Adafruit_TSL2561_Scheduler *scheduler,
+                                    uint16_t *broadband, uint16_t *ir) {
+  return Adafruit_TSL2561_ReadAwaiter(this, scheduler, broadband, ir);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts the conversion, only suspending if it can succeed
+    @returns True to carry on without suspending (the start failed)
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_ReadAwaiter::await_ready(void) {
+  _started = _sensor->startConversion();
+  return !_started;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Hands the coroutine to the scheduler until the integration is
+            over
+    @param  handle The awaiting coroutine
+    @returns True if the coroutine stays suspended, false if the scheduler
+             had no room; await_resume() then waits for the conversion
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_ReadAwaiter::await_suspend(
+    std::coroutine_handle<> handle) {
+  return _scheduler->resumeAt(handle,
+                              Adafruit_TSL2561_Unified::clockMillis() +
+                                  _sensor->getConversionTimeLeft());
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads the finished conversion
+    @returns True if both channels were read
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_ReadAwaiter::await_resume(void) {
+  if (!_started) {
+    *_broadband = 0;
+    *_ir = 0;
+    return false;
+  }
+  return _sensor->readConversion(_broadband, _ir);
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Converts the raw sensor values to the standard SI lux equivalent.
+    @param  broadband The 16-bit sensor reading from the IR+visible light diode.
+    @param  ir The 16-bit sensor reading from the IR-only light diode.
+    @returns The integer Lux value we calcuated.
+             Returns 0 if the sensor is saturated and the values are
+             unreliable, or 65536 if the sensor is saturated.
+*/
+/**************************************************************************/
+#ifdef TSL2561_WITH_LUX
+/**************************************************************************/
+/*!
+
+    Returns
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Unified::calculateLux(uint16_t broadband,
+                                                uint16_t ir) {
+  return calculateLux(broadband, ir, currentIntegrationTime(), currentGain());
+}
+
+/**************************************************************************/
+/*!
+    @brief  Converts the raw sensor values to the standard SI lux equivalent
+            for the given settings. This doesn't touch the bus or any
+            instance state, so it can be checked against a reference on a
+            host without a sensor attached.
+    @param  broadband The 16-bit sensor reading from the IR+visible light diode.
+    @param  ir The 16-bit sensor reading from the IR-only light diode.
+    @param  time The integration time the reading was taken with
+    @param  gain The gain the reading was taken with
+    @returns The integer Lux value we calcuated, or 65536 if the sensor is
+             saturated.
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Unified::calculateLux(uint16_t broadband,
+                                                uint16_t ir,
+                                                tsl2561IntegrationTime_t time,
+                                                tsl2561Gain_t gain) {
+  uint32_t temp = calculateLuxScaled(broadband, ir, time, gain);
+
+  /* Return 65536 lux if the sensor is saturated */
+  if (temp == TSL2561_LUX_SCALED_CLIPPED) {
+    return 65536;
+  }
 
   /* Round lsb (2^(LUX_SCALE-1)) */
   temp += (1 << (TSL2561_LUX_LUXSCALE - 1));
@@ -466,109 +1047,2263 @@ uint32_t Adafruit_TSL2561_Unified::calculateLux(uint16_t broadband,
 
 /**************************************************************************/
 /*!
-    @brief  Gets the most recent sensor event
-    @param  event Pointer to a sensor_event_t type that will be filled
-                  with the lux value, timestamp, data type and sensor ID.
-    @returns True if sensor reading is between 0 and 65535 lux,
-             false if sensor is saturated
+    @brief  Converts the raw sensor values to lux in fixed point, keeping
+            the precision calculateLux() drops when it strips the fraction.
+            Uses the same integer math, no floating point.
+    @param  broadband The 16-bit sensor reading from the IR+visible light diode.
+    @param  ir The 16-bit sensor reading from the IR-only light diode.
+    @returns Lux in thousandths of a lux (milli-lux), or 65536000 if the
+             sensor is saturated.
 */
 /**************************************************************************/
-bool Adafruit_TSL2561_Unified::getEvent(sensors_event_t *event) {
-  uint16_t broadband, ir;
+uint32_t Adafruit_TSL2561_Unified::calculateLuxQ(uint16_t broadband,
+                                                 uint16_t ir) {
+  uint32_t temp = calculateLuxScaled(broadband, ir, currentIntegrationTime(),
+                                     currentGain());
 
-  /* Clear the event */
-  memset(event, 0, sizeof(sensors_event_t));
+  /* Return 65536 lux if the sensor is saturated */
+  if (temp == TSL2561_LUX_SCALED_CLIPPED) {
+    return 65536000UL;
+  }
 
-  event->version = sizeof(sensors_event_t);
-  event->sensor_id = _tsl2561SensorID;
-  event->type = SENSOR_TYPE_LIGHT;
-  event->timestamp = millis();
+  return scaledToMilliLux(temp);
+}
 
-  /* Calculate the actual lux value */
-  getLuminosity(&broadband, &ir);
-  event->light = calculateLux(broadband, ir);
+/**************************************************************************/
+/*!
+    @brief  Enables or disables sub-lux output in getEvent(). When enabled,
+            event->light keeps the fractional lux from calculateLuxQ()
+            instead of being rounded to a whole lux.
+    @param enable Set to true to enable, False to disable
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::enableSubLux(bool enable) {
+  _tsl2561SubLux = enable;
+}
+#endif
 
-  if (event->light == 65536) {
+#ifdef TSL2561_WITH_RETIMING
+/**************************************************************************/
+/*!
+    @brief  Takes the best reading that completes within a time budget.
+            Gain/integration plans are tried from the finest resolution
+            down, skipping any that don't fit the time left or are
+            expected to clip at the last known light level. A clipped
+            reading is retried with a coarser plan if time remains. Bus
+            time counts against the budget too: each conversion keeps
+            TSL2561_DELAY_CONVERSION_BUS free for its transactions, a
+            retry that would back off past the deadline is not made, and
+            a conversion that retries delayed too much is abandoned for a
+            shorter one. The configured gain and integration time are
+            restored afterwards, with the next power-up.
+    @param  budget_ms Maximum time in milliseconds the call may take
+    @param  lux Pointer to a uint32_t we will fill with the lux value
+    @param  precision Pointer to a uint32_t we will fill with the lux
+                      change one count of broadband represents, in
+                      milli-lux (the achieved resolution)
+    @returns True if an unsaturated reading was taken within the budget,
+             false if no plan fits the budget, the bus failed or every
+             reading clipped
+*/
+/**************************************************************************/
+boolean Adafruit_TSL2561_Unified::getLuxWithin(uint32_t budget_ms,
+                                               uint32_t *lux,
+                                               uint32_t *precision) {
+  tsl2561Deadline_t deadline = {clockMillis(), budget_ms};
+  uint8_t savedTiming = _tsl2561Timing;
+  boolean valid = false;
+
+  *lux = 65536;
+  *precision = 0;
+
+  /* begin()'s retries count against the budget too */
+  if (!_tsl2561Initialised && !beginWithin(&deadline)) {
+    _tsl2561BusFault = true;
     return false;
   }
-  return true;
+
+  while (!valid) {
+    /* Deadline can't be met with another conversion */
+    uint32_t elapsed =
+        clockMillis() - deadline.start + TSL2561_DELAY_CONVERSION_BUS;
+    if (elapsed >= budget_ms)
+      break;
+    int8_t chosen = choosePlan(budget_ms - elapsed);
+    if (chosen < 0)
+      break;
+
+    /* The new timing goes out with the power-up, in the same transaction */
+    if (resolutionPlans[chosen] != _tsl2561Timing) {
+      _tsl2561Timing = resolutionPlans[chosen];
+      _tsl2561TimingDirty = true;
+    }
+    tsl2561IntegrationTime_t time = currentIntegrationTime();
+    tsl2561Gain_t gain = currentGain();
+
+    if (!powerUp(&deadline))
+      break;
+
+    /* Retries on the power-up ate into the budget; try a shorter plan */
+    if (clockMillis() - deadline.start + getConversionTimeLeft() +
+            TSL2561_DELAY_CONVERSION_BUS >
+        budget_ms) {
+      stopConversion(&deadline);
+      continue;
+    }
+
+    uint16_t broadband, ir;
+    if (!readConversionWithin(&broadband, &ir, &deadline))
+      break;
+
+    uint32_t scaled = calculateLuxScaled(broadband, ir, time, gain);
+    if (scaled == TSL2561_LUX_SCALED_CLIPPED) {
+      /* Nothing coarser to try */
+      if (chosen == sizeof(resolutionPlans) - 1)
+        break;
+      continue;
+    }
+
+    *lux = (scaled + (1 << (TSL2561_LUX_LUXSCALE - 1))) >>
+           TSL2561_LUX_LUXSCALE;
+    *precision = luxResolution(broadband, ir, time, gain);
+    valid = true;
+  }
+
+  /* Put the user's settings back, without a transaction of its own */
+  if (_tsl2561Timing != savedTiming) {
+    _tsl2561Timing = savedTiming;
+    _tsl2561TimingDirty = true;
+  }
+
+  return valid;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Gets the sensor_t data
-    @param  sensor A pointer to a sensor_t structure that we will fill with
-                   details about the TSL2561 and its capabilities
+    @brief  Picks the gain/integration plan for the next conversion: the
+            finest one that fits the budget and isn't expected to clip at
+            the last known light level, falling back to the coarsest plan
+            that fits
+    @param  budget_ms Time in milliseconds the conversion may take
+    @returns An index into resolutionPlans, or -1 if no plan fits
 */
 /**************************************************************************/
-void Adafruit_TSL2561_Unified::getSensor(sensor_t *sensor) {
-  /* Clear the sensor_t object */
-  memset(sensor, 0, sizeof(sensor_t));
+int8_t Adafruit_TSL2561_Unified::choosePlan(uint32_t budget_ms) {
+  int8_t chosen = -1;
+
+  for (uint8_t i = 0; i < sizeof(resolutionPlans); i++) {
+    tsl2561IntegrationTime_t time =
+        (tsl2561IntegrationTime_t)(resolutionPlans[i] & 0x03);
+    tsl2561Gain_t gain = (tsl2561Gain_t)(resolutionPlans[i] & 0x10);
+    if (integrationDelay(time) > budget_ms)
+      continue;
+    chosen = i;
+    if (_tsl2561LastLevel == TSL2561_LEVEL_CLIPPED)
+      continue;
+    uint32_t expected = ((uint32_t)_tsl2561LastLevel
+                         << (TSL2561_LEVEL_SHIFT + TSL2561_LUX_CHSCALE)) /
+                        channelScale(time, gain);
+    if (expected <= agcHighThreshold(time))
+      break;
+  }
+  return chosen;
+}
 
-  /* Insert the sensor name in the fixed length char array */
-  strncpy(sensor->name, "TSL2561", sizeof(sensor->name) - 1);
-  sensor->name[sizeof(sensor->name) - 1] = 0;
-  sensor->version = 1;
-  sensor->sensor_id = _tsl2561SensorID;
-  sensor->type = SENSOR_TYPE_LIGHT;
-  sensor->min_delay = 0;
-  sensor->max_value = 17000.0; /* Based on trial and error ... confirm! */
-  sensor->min_value = 1.0;
-  sensor->resolution = 1.0;
+/**************************************************************************/
+/*!
+    @brief  Switches to the plan choosePlan() picks for the last known
+            light level. Only the cached settings change; the TIMING
+            register is written by the next power-up, in the same
+            transaction.
+    @param  budget_ms Time in milliseconds the conversion may take
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::planTiming(uint32_t budget_ms) {
+  int8_t chosen = choosePlan(budget_ms);
+
+  if ((chosen >= 0) && (resolutionPlans[chosen] != _tsl2561Timing)) {
+    _tsl2561Timing = resolutionPlans[chosen];
+    _tsl2561TimingDirty = true;
+  }
 }
 
-/*========================================================================*/
-/*                          PRIVATE FUNCTIONS                             */
-/*========================================================================*/
+/**************************************************************************/
+/*!
+    @brief  Takes one HDR exposure. The timing goes out with the power-up,
+            in the same transaction, and bus retries stop at the deadline.
+    @param  timing TIMING register value (integration time | gain) to use
+    @param  broadband Pointer to a uint16_t we will fill with broadband
+    @param  ir Pointer to a uint16_t we will fill with IR
+    @param  deadline The start and budget of the getLuxHDR() call
+    @returns True if the exposure was read in time, false if the bus
+             failed or retries left too little time to integrate
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::exposeWithin(
+    uint8_t timing, uint16_t *broadband, uint16_t *ir,
+    const tsl2561Deadline_t *deadline) {
+  if (timing != _tsl2561Timing) {
+    _tsl2561Timing = timing;
+    _tsl2561TimingDirty = true;
+  }
+
+  if (!powerUp(deadline))
+    return false;
+
+  /* Retries on the power-up ate into the budget */
+  if (clockMillis() - deadline->start + getConversionTimeLeft() +
+          TSL2561_DELAY_CONVERSION_BUS >
+      deadline->budget) {
+    stopConversion(deadline);
+    return false;
+  }
+
+  return readConversionWithin(broadband, ir, deadline);
+}
 
 /**************************************************************************/
 /*!
-    @brief  Writes a register and an 8 bit value over I2C
-    @param  reg I2C register to write the value to
-    @param  value The 8-bit value we're writing to the register
+    @brief  Takes a short 1x exposure and a long 16x exposure back to back
+            and merges them into a single lux value with extended dynamic
+            range. Each exposure is weighted by its distance from the
+            clipping threshold and the noise floor. The long exposure uses
+            the longest integration time that still fits in what is left
+            of the budget, keeping TSL2561_DELAY_CONVERSION_BUS free for
+            its transactions. Bus retries stop at the deadline. The
+            configured gain and integration time are restored afterwards,
+            with the next power-up.
+    @param  lux Pointer to a uint32_t we will fill with the merged lux value
+    @param  budget_ms Maximum time in milliseconds the call may take
+    @returns True if at least one exposure was usable, false if both were
+             saturated, the bus failed on either exposure or the budget
+             has no room for the short one (lux is then set to 65536)
 */
 /**************************************************************************/
-void Adafruit_TSL2561_Unified::write8(uint8_t reg, uint8_t value) {
-  _i2c->beginTransmission(_addr);
-  _i2c->write(reg);
-  _i2c->write(value);
-  _i2c->endTransmission();
+boolean Adafruit_TSL2561_Unified::getLuxHDR(uint32_t *lux,
+                                            uint16_t budget_ms) {
+  tsl2561Deadline_t deadline = {clockMillis(), budget_ms};
+  uint8_t savedTiming = _tsl2561Timing;
+
+  *lux = 65536;
+
+  /* begin()'s retries count against the budget too */
+  if (!_tsl2561Initialised && !beginWithin(&deadline)) {
+    _tsl2561BusFault = true;
+    return false;
+  }
+
+  boolean valid = mergeHDR(lux, &deadline);
+
+  /* Put the user's settings back, without a transaction of its own */
+  if (_tsl2561Timing != savedTiming) {
+    _tsl2561Timing = savedTiming;
+    _tsl2561TimingDirty = true;
+  }
+
+  return valid;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Reads an 8 bit value over I2C
-    @param  reg I2C register to read from
-    @returns 8-bit value containing single byte data read
+    @brief  Takes and merges the two exposures of getLuxHDR()
+    @param  lux Pointer to a uint32_t we will fill with the merged lux value
+    @param  deadline The start and budget of the getLuxHDR() call
+    @returns True if at least one exposure was usable
 */
 /**************************************************************************/
-uint8_t Adafruit_TSL2561_Unified::read8(uint8_t reg) {
-  _i2c->beginTransmission(_addr);
-  _i2c->write(reg);
-  _i2c->endTransmission();
+bool Adafruit_TSL2561_Unified::mergeHDR(uint32_t *lux,
+                                        const tsl2561Deadline_t *deadline) {
+  /* Short exposure at 1x covers the bright end of the range */
+  uint16_t shortB, shortIR;
+  if (!exposeWithin((uint8_t)TSL2561_INTEGRATIONTIME_13MS | TSL2561_GAIN_1X,
+                    &shortB, &shortIR, deadline))
+    return false;
+  uint32_t shortLux = calculateLux(shortB, shortIR);
+  uint32_t shortWeight =
+      hdrWeight(shortB, shortIR, TSL2561_INTEGRATIONTIME_13MS);
+
+  /* Pick the longest 16x exposure that fits in the remaining budget and is
+     not predicted to clip, based on the short exposure */
+  uint32_t spent =
+      clockMillis() - deadline->start + TSL2561_DELAY_CONVERSION_BUS;
+  uint32_t remaining =
+      (deadline->budget > spent) ? deadline->budget - spent : 0;
+  uint32_t shortScale =
+      channelScale(TSL2561_INTEGRATIONTIME_13MS, TSL2561_GAIN_1X);
+  boolean haveLong = false;
+  tsl2561IntegrationTime_t longTime = TSL2561_INTEGRATIONTIME_402MS;
+  for (int8_t t = TSL2561_INTEGRATIONTIME_402MS;
+       t >= TSL2561_INTEGRATIONTIME_13MS; t--) {
+    longTime = (tsl2561IntegrationTime_t)t;
+    uint32_t predicted = (shortB * shortScale) /
+                         channelScale(longTime, TSL2561_GAIN_16X);
+    if ((integrationDelay(longTime) <= remaining) &&
+        (predicted <= clipThreshold(longTime))) {
+      haveLong = true;
+      break;
+    }
+  }
+
+  uint32_t longLux = 65536;
+  uint32_t longWeight = 0;
+  if (haveLong) {
+    /* A long exposure lost on the bus fails the call, rather than
+       passing the short one off as the HDR value */
+    uint16_t longB, longIR;
+    if (!exposeWithin((uint8_t)longTime | TSL2561_GAIN_16X, &longB, &longIR,
+                      deadline))
+      return false;
+    longLux = calculateLux(longB, longIR);
+    longWeight = hdrWeight(longB, longIR, longTime);
+  }
+
+  /* Neither exposure is in its sweet spot: use whichever isn't clipped,
+     preferring the long one as it has the better resolution */
+  uint32_t totalWeight = shortWeight + longWeight;
+  if (totalWeight == 0) {
+    *lux = (longLux != 65536) ? longLux : shortLux;
+    return (*lux != 65536);
+  }
+
+  /* Keep the weighted sum within 32 bits */
+  while (totalWeight > 0x7FFF) {
+    shortWeight >>= 1;
+    longWeight >>= 1;
+    totalWeight = shortWeight + longWeight;
+  }
+  if (totalWeight == 0) {
+    totalWeight = 1;
+  }
 
-  _i2c->requestFrom(_addr, 1);
-  return _i2c->read();
+  *lux = ((shortLux * shortWeight) + (longLux * longWeight) +
+          (totalWeight / 2)) /
+         totalWeight;
+  return true;
 }
+#endif
 
+#ifndef TSL2561_NO_UNIFIED_SENSOR
 /**************************************************************************/
 /*!
-    @brief  Reads a 16 bit values over I2C
-    @param  reg I2C register to read from
-    @returns 16-bit value containing 2-byte data read
+    @brief  Gets the most recent sensor event
+    @param  event Pointer to a sensor_event_t type that will be filled
+                  with the lux value, timestamp, data type and sensor ID.
+    @returns True if sensor reading is between 0 and 65535 lux,
+             false if sensor is saturated or the bus failed (light is then
+             0, see getBusFault())
 */
 /**************************************************************************/
-uint16_t Adafruit_TSL2561_Unified::read16(uint8_t reg) {
-  uint16_t x, t;
+bool Adafruit_TSL2561_Unified::getEvent(sensors_event_t *event) {
+  uint16_t broadband, ir;
+
+  /* Clear the event */
+  memset(event, 0, sizeof(sensors_event_t));
 
-  _i2c->beginTransmission(_addr);
-  _i2c->write(reg);
-  _i2c->endTransmission();
+  event->version = sizeof(sensors_event_t);
+  event->sensor_id = _tsl2561SensorID;
+  event->type = SENSOR_TYPE_LIGHT;
+  event->timestamp = clockMillis();
 
-  _i2c->requestFrom(_addr, 2);
-  t = _i2c->read();
-  x = _i2c->read();
-  x <<= 8;
-  x |= t;
-  return x;
+  /* Calculate the actual lux value */
+  getLuminosity(&broadband, &ir);
+  if (_tsl2561BusFault)
+    return false;
+  tsl2561IntegrationTime_t time = currentIntegrationTime();
+  tsl2561Gain_t gain = currentGain();
+  uint32_t lux = calculateLux(broadband, ir);
+
+#ifdef TSL2561_WITH_RETIMING
+  /* Re-measure with less sensitive settings if the sensor clipped */
+  _tsl2561SatRetries = 0;
+  if ((lux == 65536) && _tsl2561SatRecovery) {
+    lux = recoverSaturation(&broadband, &ir, &time, &gain);
+  }
+#endif
+
+  if (_tsl2561SubLux && (lux != 65536)) {
+    /* Keep the fractional part */
+    event->light =
+        scaledToMilliLux(calculateLuxScaled(broadband, ir, time, gain)) /
+        1000.0f;
+  } else {
+    event->light = lux;
+  }
+
+  if (event->light == 65536) {
+    return false;
+  }
+  return true;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Replaces millis()/delay() for all instances, e.g. with a fake
+            clock on a host that advances time instantly instead of sleeping
+            through each integration. Bus traces are timed with its micros,
+            or with millis() if that is NULL.
+    @param  clock Pointer to the clock to use (must stay valid), or NULL to
+                  go back to the Arduino millis() and delay()
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::setClock(const tsl2561Clock_t *clock) {
+  _clock = clock;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the current time from the configured clock
+    @returns Milliseconds since start
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Unified::clockMillis(void) {
+  return _clock ? _clock->millis() : millis();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the current time from the configured clock, with
+            microsecond resolution if it has any
+    @returns Microseconds since start
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Unified::clockMicros(void) {
+  if (!_clock)
+    return micros();
+  return _clock->micros ? _clock->micros() : _clock->millis() * 1000UL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Waits using the configured clock
+    @param  ms The number of milliseconds to wait
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::clockDelay(uint32_t ms) {
+  if (_clock) {
+    _clock->delay(ms);
+  } else {
+    delay(ms);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets how failed register transactions are retried, for all
+            instances. Each retry waits twice as long as the one before
+            (capped at 16x the first wait). By default nothing is retried.
+    @param  retries Number of extra attempts after the first one fails
+    @param  backoff_ms Wait before the first retry, 0 to retry immediately
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::setBusRetries(uint8_t retries,
+                                             uint8_t backoff_ms) {
+  _busRetries = retries;
+  _busBackoff = backoff_ms;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of failed register transactions on this sensor,
+            including ones that succeeded on a retry
+    @returns The error count, saturating at 65535
+*/
+/**************************************************************************/
+uint16_t Adafruit_TSL2561_Unified::getI2CErrorCount(void) {
+  return _tsl2561I2CErrors;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells whether the last reading was lost to a bus error that
+            outlasted the retries, rather than being a genuine zero
+    @returns True if the last conversion couldn't be started or read back
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::getBusFault(void) { return _tsl2561BusFault; }
+
+#ifdef TSL2561_WITH_HEALTH
+/**************************************************************************/
+/*!
+    @brief  Sets how often conversions are preceded by a reset check. The
+            check is a single byte read of the TIMING register. After a bus
+            fault every conversion is checked until the sensor answers again.
+    @param  readings Check before every Nth conversion, or 0 to only check
+                     after bus faults and on checkHealth()
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::setHealthCheckInterval(uint8_t readings) {
+  _tsl2561HealthInterval = readings;
+  _tsl2561HealthCount = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Checks that the sensor still answers and still holds our gain
+            and integration time. A sensor that browned out comes back
+            with the power-on TIMING value; our cached settings are then
+            written back (without a full begin()) and read back to confirm.
+    @returns True if the sensor is healthy, or was recovered
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::checkHealth(void) {
+  return checkHealthWithin(NULL);
+}
+
+/**************************************************************************/
+/*!
+    @brief  checkHealth(), with its transactions and their retries kept to
+            a deadline
+    @param  deadline Time limit for the transactions and their retries, or
+                     NULL for none
+    @returns True if the sensor is healthy, or was recovered
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::checkHealthWithin(
+    const tsl2561Deadline_t *deadline) {
+  uint8_t expected = (uint8_t)currentIntegrationTime() | currentGain();
+  uint8_t timing;
+
+  if (!read8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_TIMING, &timing,
+             deadline)) {
+    noteFault();
+    return false;
+  }
+
+#ifdef TSL2561_WITH_RETIMING
+  /* A planned timing change isn't on the device until the next power-up,
+     so only the bus can be checked */
+  if (_tsl2561TimingDirty)
+    timing = expected;
+#endif
+
+  if ((timing & 0x13) != expected) {
+    /* Reset behind our back: put the settings back and make sure they
+       stuck */
+    noteFault();
+    if (!setTiming(currentIntegrationTime(), currentGain(), deadline) ||
+        !read8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_TIMING, &timing,
+               deadline) ||
+        ((timing & 0x13) != expected)) {
+      return false;
+    }
+  }
+
+  if (_tsl2561Recovering) {
+    uint32_t elapsed = clockMillis() - _tsl2561FaultSince;
+    _tsl2561RecoveryTime = (elapsed > 0xFFFF) ? 0xFFFF : elapsed;
+    if (_tsl2561Recoveries != 0xFF)
+      _tsl2561Recoveries++;
+    _tsl2561Recovering = false;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of times the sensor was brought back after a
+            reset or bus fault
+    @returns The recovery count, saturating at 255
+*/
+/**************************************************************************/
+uint8_t Adafruit_TSL2561_Unified::getRecoveryCount(void) {
+  return _tsl2561Recoveries;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets how long the last recovery took, from the first failed or
+            mismatched transaction to the sensor holding our settings again
+    @returns The recovery time in milliseconds, saturating at 65535
+*/
+/**************************************************************************/
+uint16_t Adafruit_TSL2561_Unified::getLastRecoveryTime(void) {
+  return _tsl2561RecoveryTime;
+}
+#endif
+
+#ifdef TSL2561_BUS_LOCK
+/**************************************************************************/
+/*!
+    @brief  Sets the lock taken around each register transaction. Waits
+            (integration, retry backoff) happen with the lock released.
+    @param  lock The lock to use (must stay valid), or NULL for none
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::setBusLock(const tsl2561BusLock_t *lock) {
+  _busLock = lock;
+}
+#endif
+
+#ifdef TSL2561_BUS_TRACE
+/**************************************************************************/
+/*!
+    @brief  Sets a function to be called after every register transaction,
+            with its address, register, value and timing. Used to capture a
+            trace of the bus for later replay. Shared by all instances.
+    @param  recorder The function to call, or NULL to stop recording
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::setBusRecorder(tsl2561BusRecorder_t recorder) {
+  _busRecorder = recorder;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets a function to be called before every register transaction.
+            If it returns true the transaction is served by the function
+            (e.g. from a captured trace, where it can also flag a request
+            that differs from the capture) and the bus isn't touched.
+            Shared by all instances.
+    @param  replay The function to call, or NULL to use the bus again
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::setBusReplay(tsl2561BusReplay_t replay) {
+  _busReplay = replay;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of register transactions made by all instances,
+            including replayed ones
+    @returns The transaction count
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Unified::getBusTransactionCount(void) {
+#ifdef TSL2561_WITH_SHARED_SAMPLES
+  return __atomic_load_n(&_busTransactions, __ATOMIC_RELAXED);
+#else
+  return _busTransactions;
+#endif
+}
+#endif
+
+#ifndef TSL2561_NO_UNIFIED_SENSOR
+/**************************************************************************/
+/*!
+    @brief  Gets the sensor_t data
+    @param  sensor A pointer to a sensor_t structure that we will fill with
+                   details about the TSL2561 and its capabilities
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::getSensor(sensor_t *sensor) {
+  /* Clear the sensor_t object */
+  memset(sensor, 0, sizeof(sensor_t));
+
+  /* Insert the sensor name in the fixed length char array */
+  strncpy(sensor->name, "TSL2561", sizeof(sensor->name) - 1);
+  sensor->name[sizeof(sensor->name) - 1] = 0;
+  sensor->version = 1;
+  sensor->sensor_id = _tsl2561SensorID;
+  sensor->type = SENSOR_TYPE_LIGHT;
+  sensor->min_delay = 0;
+  sensor->max_value = 17000.0; /* Based on trial and error ... confirm! */
+  sensor->min_value = 1.0;
+  sensor->resolution = _tsl2561SubLux ? 0.001 : 1.0;
+}
+#endif
+
+/*========================================================================*/
+/*                          PRIVATE FUNCTIONS                             */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Writes the timing register and updates the cached settings.
+            Settings fixed at build time always keep their fixed value.
+    @param  time The integration time to use
+    @param  gain The gain to use
+    @param  deadline Time limit for the transactions and their retries, or
+                     NULL for none
+    @returns True if the timing register was written
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::setTiming(tsl2561IntegrationTime_t time,
+                                         tsl2561Gain_t gain,
+                                         const tsl2561Deadline_t *deadline) {
+  /* Enable the device by setting the control bit to 0x03 */
+  if (!enable(deadline))
+    return false;
+
+#ifdef TSL2561_FIXED_INTEGRATIONTIME
+  time = TSL2561_FIXED_INTEGRATIONTIME;
+#endif
+#ifdef TSL2561_FIXED_GAIN
+  gain = TSL2561_FIXED_GAIN;
+#endif
+
+  /* Update the timing register, keeping the placeholders in step with
+     what the device actually holds */
+  bool ok = write8(TSL2561_COMMAND_BIT | TSL2561_REGISTER_TIMING,
+                   (uint8_t)time | gain, deadline);
+#if !defined(TSL2561_FIXED_INTEGRATIONTIME) || !defined(TSL2561_FIXED_GAIN)
+  if (ok)
+    _tsl2561Timing = (uint8_t)time | gain;
+#endif
+
+  /* Turn the device off to save power */
+  disable(deadline);
+  return ok;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Checks that a TSL2561 answers at our address, with one read of
+            the ID register
+    @param  retry True to read it through the retry policy, as begin()
+                  does; false for a single transaction, as discover() does
+                  for addresses that are usually empty
+    @param  deadline Time limit for the retries, or NULL for none
+    @returns True if the part number is TSL2561CS or TSL2561T/FN/CL (and not
+             e.g. a TSL2560, or another device at the same address)
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::probe(bool retry,
+                                     const tsl2561Deadline_t *deadline) {
+  uint8_t reg = TSL2561_COMMAND_BIT | TSL2561_REGISTER_ID;
+  uint8_t id;
+
+  if (!(retry ? read8(reg, &id, deadline) : readOnce(reg, &id, 1)))
+    return false;
+
+  uint8_t partno = id >> 4;
+  return (partno == TSL2561_ID_PARTNO_CS) ||
+         (partno == TSL2561_ID_PARTNO_T_FN_CL);
+}
+
+#ifdef TSL2561_WITH_HEALTH
+/**************************************************************************/
+/*!
+    @brief  Starts timing a recovery, unless one is already under way
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::noteFault(void) {
+  if (!_tsl2561Recovering) {
+    _tsl2561Recovering = true;
+    _tsl2561FaultSince = clockMillis();
+  }
+}
+#endif
+
+#ifdef TSL2561_WITH_RETIMING
+/**************************************************************************/
+/*!
+    @brief  Steps the integration time down, then the gain, re-measuring
+            until the reading is no longer clipped or there is nothing left
+            to try. The configured settings are restored afterwards and the
+            number of extra conversions is kept in _tsl2561SatRetries.
+    @param  broadband Pointer to a uint16_t we will fill with the last
+                      broadband reading
+    @param  ir Pointer to a uint16_t we will fill with the last IR reading
+    @param  usedTime Optional pointer filled with the integration time the
+                     last reading was taken with
+    @param  usedGain Optional pointer filled with the gain the last reading
+                     was taken with
+    @returns The lux value of the last reading, 65536 if still saturated
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Unified::recoverSaturation(
+    uint16_t *broadband, uint16_t *ir, tsl2561IntegrationTime_t *usedTime,
+    tsl2561Gain_t *usedGain) {
+  tsl2561IntegrationTime_t savedTime = currentIntegrationTime();
+  tsl2561Gain_t savedGain = currentGain();
+  uint32_t lux = 65536;
+
+  /* Bounded even if the settings stop moving */
+  for (uint8_t step = 0; (lux == 65536) && (step < TSL2561_SAT_STEPS);
+       step++) {
+    tsl2561IntegrationTime_t time = currentIntegrationTime();
+    tsl2561Gain_t gain = currentGain();
+
+    if (time != TSL2561_INTEGRATIONTIME_13MS) {
+      time = (tsl2561IntegrationTime_t)(time - 1);
+    } else if (gain == TSL2561_GAIN_16X) {
+      gain = TSL2561_GAIN_1X;
+    } else {
+      /* Already at the least sensitive settings */
+      break;
+    }
+
+    /* The settings only move on once the device has them */
+    if (!setTiming(time, gain))
+      break;
+    if (!getData(broadband, ir))
+      break;
+    if (_tsl2561SatRetries < TSL2561_SAT_STEPS)
+      _tsl2561SatRetries++;
+    lux = calculateLux(*broadband, *ir);
+  }
+
+  if (usedTime)
+    *usedTime = currentIntegrationTime();
+  if (usedGain)
+    *usedGain = currentGain();
+
+  /* Put the user's settings back */
+  if ((currentIntegrationTime() != savedTime) || (currentGain() != savedGain)) {
+    setTiming(savedTime, savedGain);
+  }
+
+  return lux;
+}
+#endif
+
+#ifdef TSL2561_WITH_LUX
+/**************************************************************************/
+/*!
+    @brief  Converts raw sensor values to lux, keeping the fractional part
+    @param  broadband The 16-bit sensor reading from the IR+visible light diode.
+    @param  ir The 16-bit sensor reading from the IR-only light diode.
+    @param  time The integration time the reading was taken with
+    @param  gain The gain the reading was taken with
+    @param  segment Optional pointer filled with the ratio segment (1-8)
+                    whose coefficients were used
+    @returns Lux scaled by 2^TSL2561_LUX_LUXSCALE (not rounded), or
+             TSL2561_LUX_SCALED_CLIPPED if the sensor is saturated
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Unified::calculateLuxScaled(
+    uint16_t broadband, uint16_t ir, tsl2561IntegrationTime_t time,
+    tsl2561Gain_t gain, uint8_t *segment) {
+  unsigned long chScale;
+  unsigned long channel1;
+  unsigned long channel0;
+
+  /* Make sure the sensor isn't saturated! */
+  uint16_t clip = clipThreshold(time);
+  if ((broadband > clip) || (ir > clip)) {
+    return TSL2561_LUX_SCALED_CLIPPED;
+  }
+
+  chScale = channelScale(time, gain);
+
+  /* Scale the channel values */
+  channel0 = (broadband * chScale) >> TSL2561_LUX_CHSCALE;
+  channel1 = (ir * chScale) >> TSL2561_LUX_CHSCALE;
+
+  return luxFromChannels<TSL2561_PACKAGE_TYPE>(channel0, channel1, segment);
+}
+
+/**************************************************************************/
+/*!
+    @brief  A package's piecewise lux approximation, on channel values
+            already scaled to 402ms and 16x gain. Both packages are
+            instantiated below; --gc-sections drops the unused one.
+    @param  channel0 Scaled broadband channel
+    @param  channel1 Scaled IR channel
+    @param  segment Optional pointer filled with the ratio segment (1-8)
+                    whose coefficients were used
+    @returns Lux scaled by 2^TSL2561_LUX_LUXSCALE (not rounded)
+*/
+/**************************************************************************/
+template <tsl2561Package_t Package>
+uint32_t Adafruit_TSL2561_Unified::luxFromChannels(unsigned long channel0,
+                                                   unsigned long channel1,
+                                                   uint8_t *segment) {
+  /* Find the ratio of the channel values (Channel1/Channel0) */
+  unsigned long ratio1 = 0;
+  if (channel0 != 0)
+    ratio1 = (channel1 << (TSL2561_LUX_RATIOSCALE + 1)) / channel0;
+
+  /* round the ratio value */
+  unsigned long ratio = (ratio1 + 1) >> 1;
+
+  unsigned int b, m;
+  uint8_t seg;
+
+  if (Package == TSL2561_PACKAGE_TYPE_CS) {
+    if ((ratio >= 0) && (ratio <= TSL2561_LUX_K1C)) {
+      b = TSL2561_LUX_B1C;
+      m = TSL2561_LUX_M1C;
+      seg = 1;
+    } else if (ratio <= TSL2561_LUX_K2C) {
+      b = TSL2561_LUX_B2C;
+      m = TSL2561_LUX_M2C;
+      seg = 2;
+    } else if (ratio <= TSL2561_LUX_K3C) {
+      b = TSL2561_LUX_B3C;
+      m = TSL2561_LUX_M3C;
+      seg = 3;
+    } else if (ratio <= TSL2561_LUX_K4C) {
+      b = TSL2561_LUX_B4C;
+      m = TSL2561_LUX_M4C;
+      seg = 4;
+    } else if (ratio <= TSL2561_LUX_K5C) {
+      b = TSL2561_LUX_B5C;
+      m = TSL2561_LUX_M5C;
+      seg = 5;
+    } else if (ratio <= TSL2561_LUX_K6C) {
+      b = TSL2561_LUX_B6C;
+      m = TSL2561_LUX_M6C;
+      seg = 6;
+    } else if (ratio <= TSL2561_LUX_K7C) {
+      b = TSL2561_LUX_B7C;
+      m = TSL2561_LUX_M7C;
+      seg = 7;
+    } else if (ratio > TSL2561_LUX_K8C) {
+      b = TSL2561_LUX_B8C;
+      m = TSL2561_LUX_M8C;
+      seg = 8;
+    }
+  } else {
+    if ((ratio >= 0) && (ratio <= TSL2561_LUX_K1T)) {
+      b = TSL2561_LUX_B1T;
+      m = TSL2561_LUX_M1T;
+      seg = 1;
+    } else if (ratio <= TSL2561_LUX_K2T) {
+      b = TSL2561_LUX_B2T;
+      m = TSL2561_LUX_M2T;
+      seg = 2;
+    } else if (ratio <= TSL2561_LUX_K3T) {
+      b = TSL2561_LUX_B3T;
+      m = TSL2561_LUX_M3T;
+      seg = 3;
+    } else if (ratio <= TSL2561_LUX_K4T) {
+      b = TSL2561_LUX_B4T;
+      m = TSL2561_LUX_M4T;
+      seg = 4;
+    } else if (ratio <= TSL2561_LUX_K5T) {
+      b = TSL2561_LUX_B5T;
+      m = TSL2561_LUX_M5T;
+      seg = 5;
+    } else if (ratio <= TSL2561_LUX_K6T) {
+      b = TSL2561_LUX_B6T;
+      m = TSL2561_LUX_M6T;
+      seg = 6;
+    } else if (ratio <= TSL2561_LUX_K7T) {
+      b = TSL2561_LUX_B7T;
+      m = TSL2561_LUX_M7T;
+      seg = 7;
+    } else if (ratio > TSL2561_LUX_K8T) {
+      b = TSL2561_LUX_B8T;
+      m = TSL2561_LUX_M8T;
+      seg = 8;
+    }
+  }
+
+  unsigned long temp;
+  channel0 = channel0 * b;
+  channel1 = channel1 * m;
+
+  temp = 0;
+  /* Do not allow negative lux value */
+  if (channel0 > channel1)
+    temp = channel0 - channel1;
+
+  if (segment)
+    *segment = seg;
+
+  return temp;
+}
+
+template uint32_t
+Adafruit_TSL2561_Unified::luxFromChannels<TSL2561_PACKAGE_TYPE_T_FN_CL>(
+    unsigned long channel0, unsigned long channel1, uint8_t *segment);
+template uint32_t
+Adafruit_TSL2561_Unified::luxFromChannels<TSL2561_PACKAGE_TYPE_CS>(
+    unsigned long channel0, unsigned long channel1, uint8_t *segment);
+
+/**************************************************************************/
+/*!
+    @brief  Estimates the resolution of a reading: the lux change that one
+            more count of broadband would make
+    @param  broadband The 16-bit sensor reading from the IR+visible light diode.
+    @param  ir The 16-bit sensor reading from the IR-only light diode.
+    @param  time The integration time the reading was taken with
+    @param  gain The gain the reading was taken with
+    @returns The resolution in milli-lux
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Unified::luxResolution(uint16_t broadband,
+                                                 uint16_t ir,
+                                                 tsl2561IntegrationTime_t time,
+                                                 tsl2561Gain_t gain) {
+  /* Step down instead of up at the clipping threshold */
+  if (broadband >= clipThreshold(time)) {
+    broadband--;
+  }
+
+  uint32_t lo = calculateLuxScaled(broadband, ir, time, gain);
+  uint32_t hi = calculateLuxScaled(broadband + 1, ir, time, gain);
+  if ((lo == TSL2561_LUX_SCALED_CLIPPED) || (hi <= lo)) {
+    return 0;
+  }
+  return ((hi - lo) * 1000) >> TSL2561_LUX_LUXSCALE;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Writes a register and an 8 bit value over I2C, retrying
+            according to the retry policy
+    @param  reg I2C register to write the value to
+    @param  value The 8-bit value we're writing to the register
+    @param  deadline Time limit for the retries, or NULL for none
+    @returns True if the device acknowledged the write
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::write8(uint8_t reg, uint8_t value,
+                                      const tsl2561Deadline_t *deadline) {
+  for (uint8_t attempt = 0;; attempt++) {
+    if (writeOnce(reg, value, 1))
+      return true;
+    if (!retryAfterError(attempt, deadline))
+      return false;
+  }
+}
+
+#if defined(TSL2561_WITH_RETIMING) && defined(TSL2561_FOLD_TIMING)
+/**************************************************************************/
+/*!
+    @brief  Writes a 16 bit value over I2C, low byte first, retrying
+            according to the retry policy
+    @param  reg I2C register (command byte, with the word bit) to write to
+    @param  value The 16-bit value we're writing
+    @param  deadline Time limit for the retries, or NULL for none
+    @returns True if the device acknowledged the write
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::write16(uint8_t reg, uint16_t value,
+                                       const tsl2561Deadline_t *deadline) {
+  for (uint8_t attempt = 0;; attempt++) {
+    if (writeOnce(reg, value, 2))
+      return true;
+    if (!retryAfterError(attempt, deadline))
+      return false;
+  }
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Reads an 8 bit value over I2C
+    @param  reg I2C register to read from
+    @param  value Pointer to a uint8_t we will fill with the byte read
+    @param  deadline Time limit for the retries, or NULL for none
+    @returns True if the byte was received
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::read8(uint8_t reg, uint8_t *value,
+                                     const tsl2561Deadline_t *deadline) {
+  return readBlock(reg, value, 1, deadline);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads a 16 bit values over I2C
+    @param  reg I2C register to read from
+    @param  value Pointer to a uint16_t we will fill with the 2-byte data
+                  read, or 0 if the device didn't return both bytes (a
+                  short read would otherwise look like saturation)
+    @param  deadline Time limit for the retries, or NULL for none
+    @returns True if both bytes were received
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::read16(uint8_t reg, uint16_t *value,
+                                      const tsl2561Deadline_t *deadline) {
+  uint8_t buffer[2];
+
+  if (!readBlock(reg, buffer, 2, deadline)) {
+    *value = 0;
+    return false;
+  }
+  *value = ((uint16_t)buffer[1] << 8) | buffer[0];
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads consecutive bytes over I2C, retrying according to the
+            retry policy
+    @param  reg I2C register (command byte) to read from
+    @param  buffer Pointer to at least len bytes we will fill
+    @param  len Number of bytes to read (1 or 2)
+    @param  deadline Time limit for the retries, or NULL for none
+    @returns True if all len bytes were received
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::readBlock(uint8_t reg, uint8_t *buffer,
+                                         uint8_t len,
+                                         const tsl2561Deadline_t *deadline) {
+  for (uint8_t attempt = 0;; attempt++) {
+    if (readOnce(reg, buffer, len))
+      return true;
+    if (!retryAfterError(attempt, deadline))
+      return false;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Counts a failed transaction and waits before the next attempt
+    @param  attempt Number of attempts already retried (0 after the first
+                    failure)
+    @param  deadline Time limit the retry, and a conversion's transactions
+                     after it, must fit in, or NULL for none
+    @returns True if the transaction should be tried again
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::retryAfterError(
+    uint8_t attempt, const tsl2561Deadline_t *deadline) {
+  if (_tsl2561I2CErrors != 0xFFFF)
+    _tsl2561I2CErrors++;
+
+  return retryWait(attempt, deadline);
+}
+
+/**************************************************************************/
+/*!
+    @brief  The retry policy set by setBusRetries(), shared with
+            Adafruit_TSL2561_Fixed: waits before the next attempt
+    @param  attempt Number of attempts already retried (0 after the first
+                    failure)
+    @param  deadline Time limit the retry, and a conversion's transactions
+                     after it, must fit in, or NULL for none
+    @returns True if the transaction should be tried again
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::retryWait(uint8_t attempt,
+                                         const tsl2561Deadline_t *deadline) {
+  if (attempt >= _busRetries)
+    return false;
+
+  /* Back off exponentially, capped so a dead bus can't stall for long */
+  uint32_t wait = 0;
+  if (_busBackoff) {
+    uint8_t shift = (attempt < 4) ? attempt : 4;
+    wait = (uint32_t)_busBackoff << shift;
+  }
+
+  /* Give up rather than let the retry and the transactions after it run
+     past the caller's deadline */
+  if (deadline && (clockMillis() - deadline->start + wait +
+                       TSL2561_DELAY_CONVERSION_BUS >
+                   deadline->budget))
+    return false;
+
+  if (wait)
+    clockDelay(wait);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Single attempt at writing a register, with this sensor's bus
+            lock, trace and energy accounting around busWrite()
+    @param  reg I2C register to write the value to
+    @param  value The value we're writing, low byte first
+    @param  len Number of bytes to write (1 or 2)
+    @returns True if endTransmission() reported success
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::writeOnce(uint8_t reg, uint16_t value,
+                                         uint8_t len) {
+  bool ok;
+
+#ifdef TSL2561_BUS_TRACE
+  tsl2561BusRecord_t record;
+  if (traceBegin(&record, reg, len, false, value)) {
+#ifdef TSL2561_ENERGY
+    noteTransfer(reg, len, false, value & 0xFF, record.ok);
+#endif
+    return record.ok;
+  }
+#endif
+
+  if (!_i2c)
+    return false;
+
+#ifdef TSL2561_BUS_LOCK
+  lockBus();
+#endif
+  ok = busWrite(_i2c, address(), reg, value, len);
+#ifdef TSL2561_BUS_LOCK
+  unlockBus();
+#endif
+#ifdef TSL2561_ENERGY
+  noteTransfer(reg, len, false, value & 0xFF, ok);
+#endif
+
+#ifdef TSL2561_BUS_TRACE
+  traceEnd(&record, value, ok);
+#endif
+  return ok;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Single attempt at reading consecutive bytes, with this sensor's
+            bus lock, trace and energy accounting around busRead()
+    @param  reg I2C register (command byte) to read from
+    @param  buffer Pointer to at least len bytes we will fill
+    @param  len Number of bytes to read (1 or 2)
+    @returns True if the register was addressed and all len bytes received
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::readOnce(uint8_t reg, uint8_t *buffer,
+                                        uint8_t len) {
+  bool ok;
+
+#ifdef TSL2561_BUS_TRACE
+  tsl2561BusRecord_t record;
+  if (traceBegin(&record, reg, len, true, 0)) {
+    if (record.ok) {
+      buffer[0] = record.value & 0xFF;
+      if (len > 1)
+        buffer[1] = record.value >> 8;
+    }
+#ifdef TSL2561_ENERGY
+    noteTransfer(reg, len, true, 0, record.ok);
+#endif
+    return record.ok;
+  }
+#endif
+
+  if (!_i2c)
+    return false;
+
+#ifdef TSL2561_BUS_LOCK
+  lockBus();
+#endif
+  ok = busRead(_i2c, address(), reg, buffer, len);
+#ifdef TSL2561_BUS_LOCK
+  unlockBus();
+#endif
+#ifdef TSL2561_ENERGY
+  noteTransfer(reg, len, true, 0, ok);
+#endif
+
+#ifdef TSL2561_BUS_TRACE
+  uint16_t value = 0;
+  if (ok) {
+    value = buffer[0];
+    if (len > 1)
+      value |= (uint16_t)buffer[1] << 8;
+  }
+  traceEnd(&record, value, ok);
+#endif
+  return ok;
+}
+
+/**************************************************************************/
+/*!
+    @brief  One register write transaction. This and busRead() are the only
+            places the bus is touched, by Adafruit_TSL2561_Unified and
+            Adafruit_TSL2561_Fixed alike.
+    @param  bus The bus the device is on
+    @param  addr The device's I2C address
+    @param  reg I2C register to write the value to
+    @param  value The value we're writing, low byte first
+    @param  len Number of bytes to write (1 or 2)
+    @returns True if endTransmission() reported success
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::busWrite(TwoWire *bus, uint8_t addr,
+                                        uint8_t reg, uint16_t value,
+                                        uint8_t len) {
+  bus->beginTransmission(addr);
+  bus->write(reg);
+  bus->write(value & 0xFF);
+  if (len > 1)
+    bus->write(value >> 8);
+  return (bus->endTransmission() == 0);
+}
+
+/**************************************************************************/
+/*!
+    @brief  One register read transaction
+    @param  bus The bus the device is on
+    @param  addr The device's I2C address
+    @param  reg I2C register (command byte) to read from
+    @param  buffer Pointer to at least len bytes we will fill
+    @param  len Number of bytes to read (1 or 2)
+    @returns True if the register was addressed and all len bytes received
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::busRead(TwoWire *bus, uint8_t addr,
+                                       uint8_t reg, uint8_t *buffer,
+                                       uint8_t len) {
+  bus->beginTransmission(addr);
+  bus->write(reg);
+
+  /* Don't trust read() for bytes the device never sent */
+  if ((bus->endTransmission() != 0) || (bus->requestFrom(addr, len) != len))
+    return false;
+  for (uint8_t i = 0; i < len; i++) {
+    buffer[i] = bus->read();
+  }
+  return true;
+}
+
+#ifdef TSL2561_ENERGY
+/**************************************************************************/
+/*!
+    @brief  Accounts for one register transaction: its bytes on the bus,
+            and any power-up or power-down it made
+    @param  reg Command byte
+    @param  len Number of data bytes
+    @param  read True for a register read
+    @param  value Value written
+    @param  ok True if the device acknowledged the transaction
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::noteTransfer(uint8_t reg, uint8_t len,
+                                            bool read, uint8_t value,
+                                            bool ok) {
+  /* Address and command byte, then the address again for a read */
+  _tsl2561BusBytes += (read ? 3 : 2) + len;
+
+  if (!ok || read || ((reg & 0x0F) != TSL2561_REGISTER_CONTROL))
+    return;
+
+  bool powered = ((value & 0x03) == TSL2561_CONTROL_POWERON);
+  if (powered == _tsl2561Powered)
+    return;
+
+  uint32_t now = clockMillis();
+  if (powered)
+    _tsl2561PoweredAt = now;
+  else
+    _tsl2561OnTime += now - _tsl2561PoweredAt;
+  _tsl2561Powered = powered;
+  _tsl2561PowerTransitions++;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the power and bus activity since construction or the last
+            resetEnergy(), with an estimate of the charge the sensor drew
+            from the datasheet supply currents
+    @param  energy Pointer to the structure to fill in
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::getEnergy(tsl2561Energy_t *energy) {
+  uint32_t now = clockMillis();
+
+  energy->elapsed_ms = now - _tsl2561EnergySince;
+  energy->onTime_ms = _tsl2561OnTime;
+  if (_tsl2561Powered)
+    energy->onTime_ms += now - _tsl2561PoweredAt;
+  energy->powerTransitions = _tsl2561PowerTransitions;
+  energy->busBytes = _tsl2561BusBytes;
+
+  /* uA * ms / 3600000 = uAh */
+  float offTime = (float)(energy->elapsed_ms - energy->onTime_ms);
+  energy->charge_uAh = (TSL2561_SUPPLY_ACTIVE_UA * energy->onTime_ms +
+                        TSL2561_SUPPLY_POWERDOWN_UA * offTime) /
+                       3600000.0f;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts the energy accounting over. The power state is kept, so
+            a sensor that is powered up keeps accruing on time.
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::resetEnergy(void) {
+  uint32_t now = clockMillis();
+
+  _tsl2561EnergySince = now;
+  _tsl2561PoweredAt = now;
+  _tsl2561OnTime = 0;
+  _tsl2561PowerTransitions = 0;
+  _tsl2561BusBytes = 0;
+}
+#endif
+
+#ifdef TSL2561_BUS_TRACE
+/**************************************************************************/
+/*!
+    @brief  Starts tracing a register transaction and offers it to the
+            replay hook
+    @param  record Pointer to the record to fill in
+    @param  reg The command byte of the transaction
+    @param  len Number of data bytes written or read
+    @param  read True for a read, false for a write
+    @param  value The value being written, 0 for reads
+    @returns True if the replay hook served the transaction, in which case
+             the bus must not be used, record->value holds any read data
+             and record->ok says whether it succeeded
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Unified::traceBegin(tsl2561BusRecord_t *record,
+                                          uint8_t reg, uint8_t len, bool read,
+                                          uint16_t value) {
+  record->timestamp = clockMillis();
+  record->duration_us = clockMicros();
+  record->addr = address();
+  record->reg = reg;
+  record->len = len;
+  record->read = read;
+  record->ok = true;
+  record->value = value;
+
+  if (_busReplay && _busReplay(record)) {
+    traceEnd(record, record->value, record->ok);
+    return true;
+  }
+  return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Finishes tracing a register transaction and passes it to the
+            recorder hook
+    @param  record Pointer to the record started by traceBegin()
+    @param  value The value written or read
+    @param  ok True if the transaction succeeded
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Unified::traceEnd(tsl2561BusRecord_t *record,
+                                        uint16_t value, bool ok) {
+  record->duration_us = clockMicros() - record->duration_us;
+  record->value = value;
+  record->ok = ok;
+#ifdef TSL2561_WITH_SHARED_SAMPLES
+  /* Bus workers on other cores trace their transactions too */
+  __atomic_fetch_add(&_busTransactions, 1, __ATOMIC_RELAXED);
+#else
+  _busTransactions++;
+#endif
+
+  if (_busRecorder)
+    _busRecorder(record);
+}
+#endif
+
+#ifdef TSL2561_BUS_TRACE
+/*========================================================================*/
+/*                            BUS CAPTURE                                 */
+/*========================================================================*/
+
+Adafruit_TSL2561_BusCapture *Adafruit_TSL2561_BusCapture::_active = NULL;
+
+/**************************************************************************/
+/*!
+    @brief  Sets up a capture in a buffer the caller owns
+    @param  records Buffer for the transactions (must stay valid)
+    @param  capacity Number of records the buffer holds
+*/
+/**************************************************************************/
+Adafruit_TSL2561_BusCapture::Adafruit_TSL2561_BusCapture(
+    tsl2561BusRecord_t *records, uint16_t capacity) {
+  _records = records;
+  _capacity = capacity;
+  _count = 0;
+  _position = 0;
+  _requests = 0;
+  _added = 0;
+  _skipped = 0;
+  _divergence = -1;
+  _known = 0;
+  _overflow = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts recording every register transaction into the buffer,
+            from the start of it
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_BusCapture::record(void) {
+  stop();
+  _count = 0;
+  _overflow = false;
+  _active = this;
+  Adafruit_TSL2561_Unified::setBusRecorder(recordHook);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts serving register transactions from the buffer instead of
+            the bus, in order. A request that doesn't match the next record
+            is looked for in the following TSL2561_CAPTURE_RESYNC records
+            (for reads, only up to the next write), and the ones passed
+            over count as dropped. A request not found there counts as
+            added: a write succeeds, and a read gets what was last written
+            to or read from those registers during the replay (or fails if
+            nothing was). The bus is never used while replaying.
+    @param  count Number of records in the buffer, e.g. getCount() after
+                  record(), or the size of a trace loaded into it
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_BusCapture::replay(uint16_t count) {
+  stop();
+  _count = (count < _capacity) ? count : _capacity;
+  _position = 0;
+  _requests = 0;
+  _added = 0;
+  _skipped = 0;
+  _divergence = -1;
+  _known = 0;
+  _active = this;
+  Adafruit_TSL2561_Unified::setBusReplay(replayHook);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stops recording or replaying. The results stay available.
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_BusCapture::stop(void) {
+  if (_active != this)
+    return;
+  Adafruit_TSL2561_Unified::setBusRecorder(NULL);
+  Adafruit_TSL2561_Unified::setBusReplay(NULL);
+  _active = NULL;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of records captured, or being replayed
+    @returns The record count
+*/
+/**************************************************************************/
+uint16_t Adafruit_TSL2561_BusCapture::getCount(void) { return _count; }
+
+/**************************************************************************/
+/*!
+    @brief  Checks whether recording ran out of buffer
+    @returns True if transactions were left out of the capture
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_BusCapture::getOverflow(void) { return _overflow; }
+
+/**************************************************************************/
+/*!
+    @brief  Gets where the replayed requests first stopped matching the
+            capture
+    @returns Index of the first record that wasn't requested in order, or
+             -1 if every request so far matched
+*/
+/**************************************************************************/
+int32_t Adafruit_TSL2561_BusCapture::getDivergence(void) {
+  return _divergence;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of requests made during replay that weren't in
+            the capture. Like getDropped(), this is the replay's best guess
+            at lining the requests up with the capture.
+    @returns The added transaction count
+*/
+/**************************************************************************/
+uint16_t Adafruit_TSL2561_BusCapture::getAdded(void) { return _added; }
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of captured transactions the replayed driver
+            hasn't made, including those not reached yet
+    @returns The dropped transaction count
+*/
+/**************************************************************************/
+uint16_t Adafruit_TSL2561_BusCapture::getDropped(void) {
+  return _skipped + (_count - _position);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Compares the number of transactions made during replay with
+            the number captured
+    @returns Transactions made minus transactions captured: negative if the
+             replayed driver needed fewer
+*/
+/**************************************************************************/
+int32_t Adafruit_TSL2561_BusCapture::getTransactionDiff(void) {
+  return (int32_t)_requests - _count;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Recorder hook: appends a transaction to the active capture
+    @param  record The transaction
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_BusCapture::recordHook(const tsl2561BusRecord_t *record) {
+  Adafruit_TSL2561_BusCapture *capture = _active;
+  if (!capture)
+    return;
+  if (capture->_count < capture->_capacity) {
+    capture->_records[capture->_count++] = *record;
+  } else {
+    capture->_overflow = true;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Replay hook: serves a transaction from the active capture
+    @param  record The request, filled in with the captured response
+    @returns True, so the bus is never used
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_BusCapture::replayHook(tsl2561BusRecord_t *record) {
+  Adafruit_TSL2561_BusCapture *capture = _active;
+  if (!capture)
+    return false;
+  capture->serve(record);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Checks whether a request is the one a record captured: the same
+            register, direction and size, and for writes the same value
+    @param  captured The record
+    @param  request The request
+    @returns True if they match
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_BusCapture::matches(const tsl2561BusRecord_t *captured,
+                                          const tsl2561BusRecord_t *request) {
+  return (captured->addr == request->addr) &&
+         (captured->reg == request->reg) && (captured->len == request->len) &&
+         (captured->read == request->read) &&
+         (captured->read || (captured->value == request->value));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Answers one request from the capture, resyncing or counting it
+            as added if it isn't the next record
+    @param  request The request, filled in with the response
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_BusCapture::serve(tsl2561BusRecord_t *request) {
+  uint16_t last = _position + TSL2561_CAPTURE_RESYNC;
+  _requests++;
+
+  for (uint16_t i = _position; (i < _count) && (i <= last); i++) {
+    if (!matches(&_records[i], request)) {
+      /* An extra read mustn't skip past a change of the chip's state */
+      if (request->read && !_records[i].read)
+        break;
+      continue;
+    }
+    if (i != _position) {
+      if (_divergence < 0)
+        _divergence = _position;
+      _skipped += i - _position;
+    }
+    request->ok = _records[i].ok;
+    if (request->read)
+      request->value = _records[i].value;
+    _position = i + 1;
+    shadow(request);
+    return;
+  }
+
+  /* Not in the capture: writes succeed, reads get the registers' values
+     as far as the replay has seen them */
+  if (_divergence < 0)
+    _divergence = _position;
+  _added++;
+  request->ok = true;
+  if (request->read) {
+    uint8_t reg = request->reg & 0x0F;
+    request->value = 0;
+    for (uint8_t b = 0; b < request->len; b++, reg = (reg + 1) & 0x0F) {
+      if (!(_known & (1 << reg)))
+        request->ok = false;
+      request->value |= (uint16_t)_shadow[reg] << (8 * b);
+    }
+  }
+  shadow(request);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Keeps track of the register values a successful transaction
+            wrote or read, for answering requests that aren't in the capture
+    @param  record The transaction, with its response
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_BusCapture::shadow(const tsl2561BusRecord_t *record) {
+  if (!record->ok)
+    return;
+  uint8_t reg = record->reg & 0x0F;
+  for (uint8_t b = 0; b < record->len; b++, reg = (reg + 1) & 0x0F) {
+    _shadow[reg] = record->value >> (8 * b);
+    _known |= 1 << reg;
+  }
+}
+#endif
+
+/*========================================================================*/
+/*                              I2C MUX                                   */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Constructor
+    @param  bus The bus the mux is on, already begun
+    @param  addr The I2C address of the mux, 0x70 to 0x77
+*/
+/**************************************************************************/
+Adafruit_TSL2561_Mux::Adafruit_TSL2561_Mux(TwoWire *bus, uint8_t addr) {
+  _bus = bus;
+  _addr = addr;
+  _channel = TSL2561_MUX_NONE;
+  _selects = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Routes the bus to a single downstream channel. Nothing is sent
+            if the mux is already known to be on that channel.
+    @param  channel The channel to select (0-7), or TSL2561_MUX_NONE to
+                    disconnect all of them
+    @returns True if the mux is on the requested channel
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Mux::select(uint8_t channel) {
+  if (channel == _channel)
+    return true;
+
+  _bus->beginTransmission(_addr);
+  _bus->write((channel < TSL2561_MUX_CHANNELS) ? (1 << channel) : 0);
+  if (_selects != 0xFFFF)
+    _selects++;
+  if (_bus->endTransmission() != 0) {
+    _channel = TSL2561_MUX_NONE;
+    return false;
+  }
+
+  _channel = channel;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Forgets which channel the mux is on, so that the next select()
+            writes it. Call this if anything else may have switched the mux.
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Mux::invalidate(void) { _channel = TSL2561_MUX_NONE; }
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of channel select writes sent to the mux
+    @returns The write count, saturating at 65535
+*/
+/**************************************************************************/
+uint16_t Adafruit_TSL2561_Mux::getSelectCount(void) { return _selects; }
+
+/**************************************************************************/
+/*!
+    @brief  Starts a conversion on every sensor, one channel at a time in
+            ascending order, so that all of the integrations overlap
+    @param  slots Sensors and the channels they are on, in any order
+    @param  count Number of slots
+    @returns The number of conversions started
+*/
+/**************************************************************************/
+uint8_t Adafruit_TSL2561_Mux::startAll(tsl2561MuxSlot_t *slots,
+                                       uint8_t count) {
+  uint8_t started = 0;
+
+  for (uint8_t ch = 0; ch < TSL2561_MUX_CHANNELS; ch++) {
+    for (uint8_t i = 0; i < count; i++) {
+      if (slots[i].channel != ch)
+        continue;
+      slots[i].valid = false;
+      if (select(ch) && slots[i].sensor->startConversion())
+        started++;
+    }
+  }
+
+  return started;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Reads back the conversions started by startAll(). Channels are
+            visited in descending order, so the first channel read is the
+            one startAll() left selected, and the last one is where the
+            next startAll() begins. Only the first sensor read has to wait.
+    @param  slots The slots given to startAll()
+    @param  count Number of slots
+    @returns The number of sensors read
+*/
+/**************************************************************************/
+uint8_t Adafruit_TSL2561_Mux::readAll(tsl2561MuxSlot_t *slots, uint8_t count) {
+  uint8_t read = 0;
+
+  for (int8_t ch = TSL2561_MUX_CHANNELS - 1; ch >= 0; ch--) {
+    for (uint8_t i = 0; i < count; i++) {
+      if (slots[i].channel != ch)
+        continue;
+      if (!select(ch)) {
+        /* Drop the conversion, so that it isn't read back later as a
+           fresh one. The power-down goes wherever the mux was left: a
+           channel above, read already, or none */
+        slots[i].sensor->stopConversion();
+        continue;
+      }
+      slots[i].valid =
+          slots[i].sensor->readConversion(&slots[i].broadband, &slots[i].ir);
+      if (slots[i].valid)
+        read++;
+    }
+  }
+
+  return read;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Takes one reading from every sensor behind the mux, in about
+            the time of a single integration
+    @param  slots Sensors and the channels they are on, filled with the
+                  readings
+    @param  count Number of slots
+    @returns The number of sensors read
+*/
+/**************************************************************************/
+uint8_t Adafruit_TSL2561_Mux::scan(tsl2561MuxSlot_t *slots, uint8_t count) {
+  startAll(slots, count);
+  return readAll(slots, count);
+}
+
+#ifdef TSL2561_WITH_SHARED_SAMPLES
+/*========================================================================*/
+/*                           BUS WORKER                                   */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Constructor
+    @param  sensors Array of count sensors, all on the same bus and begun.
+                    No other task may use them or the bus.
+    @param  samples Array of count samples to publish into, one per sensor
+    @param  count Number of sensors
+*/
+/**************************************************************************/
+Adafruit_TSL2561_BusWorker::Adafruit_TSL2561_BusWorker(
+    Adafruit_TSL2561_Unified *const *sensors, tsl2561SharedSample_t *samples,
+    uint8_t count) {
+  _sensors = sensors;
+  _samples = samples;
+  _count = count;
+  _rounds = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Takes one reading from every sensor and publishes it. The
+            conversions are all started before any is read, so a round
+            takes about one integration time however many sensors there
+            are.
+    @returns The number of sensors read
+*/
+/**************************************************************************/
+uint8_t Adafruit_TSL2561_BusWorker::run(void) {
+  uint8_t read = 0;
+
+  for (uint8_t i = 0; i < _count; i++) {
+    _sensors[i]->startConversion();
+  }
+
+  for (uint8_t i = 0; i < _count; i++) {
+    uint16_t broadband, ir;
+    bool valid = _sensors[i]->readConversion(&broadband, &ir);
+    publish(&_samples[i], valid, broadband, ir,
+            Adafruit_TSL2561_Unified::clockMillis());
+    if (valid)
+      read++;
+  }
+
+  _rounds++;
+  return read;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of rounds run() has completed
+    @returns The round count
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_BusWorker::getRounds(void) { return _rounds; }
+
+/**************************************************************************/
+/*!
+    @brief  Updates a shared sample. The sequence number is odd while the
+            fields are written, so readers can tell a torn copy. Only one
+            task may publish into a given sample.
+    @param  sample The sample to update
+    @param  valid False if the reading failed
+    @param  broadband Broadband reading
+    @param  ir IR reading
+    @param  timestamp Time the reading was taken, in milliseconds
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_BusWorker::publish(tsl2561SharedSample_t *sample,
+                                         bool valid, uint16_t broadband,
+                                         uint16_t ir, uint32_t timestamp) {
+  uint32_t seq = __atomic_load_n(&sample->sequence, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&sample->sequence, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&sample->valid, valid, __ATOMIC_RELAXED);
+  __atomic_store_n(&sample->broadband, broadband, __ATOMIC_RELAXED);
+  __atomic_store_n(&sample->ir, ir, __ATOMIC_RELAXED);
+  __atomic_store_n(&sample->timestamp, timestamp, __ATOMIC_RELAXED);
+  __atomic_store_n(&sample->sequence, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Copies a shared sample, retrying if it was being updated. Safe
+            to call from any task or core, and never blocks the publisher.
+    @param  sample The sample to read
+    @param  broadband Pointer to a uint16_t we will fill with the broadband
+                      reading
+    @param  ir Pointer to a uint16_t we will fill with the IR reading
+    @param  timestamp Optional pointer filled with the time of the reading
+    @returns True if the sample holds a valid reading
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_BusWorker::readShared(const tsl2561SharedSample_t *sample,
+                                            uint16_t *broadband, uint16_t *ir,
+                                            uint32_t *timestamp) {
+  uint32_t before, after;
+  bool valid;
+  uint32_t time;
+
+  /* The fields are read atomically too: a copy that races with publish()
+     is thrown away, but the race itself must not be undefined */
+  do {
+    before = __atomic_load_n(&sample->sequence, __ATOMIC_ACQUIRE);
+    valid = __atomic_load_n(&sample->valid, __ATOMIC_RELAXED);
+    *broadband = __atomic_load_n(&sample->broadband, __ATOMIC_RELAXED);
+    *ir = __atomic_load_n(&sample->ir, __ATOMIC_RELAXED);
+    time = __atomic_load_n(&sample->timestamp, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    after = __atomic_load_n(&sample->sequence, __ATOMIC_RELAXED);
+  } while ((before != after) || (before & 1));
+
+  if (timestamp)
+    *timestamp = time;
+  return valid;
+}
+#endif
+
+/*========================================================================*/
+/*                        CONTINUOUS ENGINE                               */
+/*========================================================================*/
+
+/**************************************************************************/
+/*!
+    @brief  Constructor
+    @param  sensor The sensor to acquire from, already begun. It shouldn't
+                   be read any other way while the engine runs.
+*/
+/**************************************************************************/
+Adafruit_TSL2561_Engine::Adafruit_TSL2561_Engine(
+    Adafruit_TSL2561_Unified *sensor) {
+  _sensor = sensor;
+  _interval = 0;
+  _minInterval = 0;
+  _maxInterval = 0;
+  _adaptiveSince = 0;
+  _samples = 0;
+  _change = 0;
+  _lastBroadband = 0;
+#ifdef TSL2561_WITH_RETIMING
+  _planBudget = 0;
+#endif
+  _lastStart = 0;
+  _low = 0;
+  _high = 0xFFFFFFFFUL;
+  _converting = false;
+  _started = false;
+  _haveLast = false;
+  _zone = 0;
+  memset(&_last, 0, sizeof(_last));
+  memset(_listeners, 0, sizeof(_listeners));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the time from the start of one conversion to the start of
+            the next
+    @param  ms The sample interval in milliseconds, or 0 to start the next
+               conversion as soon as the last one has been read
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Engine::setInterval(uint32_t ms) {
+  _interval = ms;
+  _maxInterval = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Adapts the sample interval to the light. When the broadband
+            reading moves by more than change counts between two samples
+            the interval drops to minMs; while it stays within change the
+            interval doubles after each sample, up to maxMs.
+    @param  minMs Interval while the light is changing (at least 1)
+    @param  maxMs Longest interval while the light is steady
+    @param  change Broadband difference, in counts, treated as a change
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Engine::setAdaptiveInterval(uint32_t minMs,
+                                                  uint32_t maxMs,
+                                                  uint16_t change) {
+  _minInterval = minMs ? minMs : 1;
+  _maxInterval = (maxMs > _minInterval) ? maxMs : _minInterval;
+  _change = change;
+  _interval = _minInterval;
+  _samples = 0;
+  _adaptiveSince = Adafruit_TSL2561_Unified::clockMillis();
+}
+
+#ifdef TSL2561_WITH_RETIMING
+/**************************************************************************/
+/*!
+    @brief  Wakes the sensor every few seconds for a single conversion and
+            powers it down straight after. Each wake uses the finest
+            gain/integration plan that fits budget_ms and isn't expected to
+            clip at the last level read, and the change of plan goes out
+            with the power-up write, so a wake is just the power-up, the
+            two channel reads and the power-down. The sensor's gain and
+            integration time follow the plans.
+    @param  seconds Time between wakes
+    @param  budget_ms Longest integration to use; 0 keeps the current gain
+                      and integration time. The default, 101ms, is where
+                      the saving comes from: with
+                      TSL2561_DELAY_INTTIME_402MS most wakes indoors or at
+                      night take 402ms at 16x, and the duty cycle saves
+                      little over getEvent().
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Engine::setDutyCycle(uint16_t seconds,
+                                           uint16_t budget_ms) {
+  setInterval((uint32_t)seconds * 1000);
+  _planBudget = budget_ms;
+}
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Gets the current sample interval
+    @returns The interval in milliseconds
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Engine::getInterval(void) { return _interval; }
+
+/**************************************************************************/
+/*!
+    @brief  Gets the number of samples taken since adaptive sampling was
+            turned on (or since construction)
+    @returns The sample count
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Engine::getSampleCount(void) { return _samples; }
+
+/**************************************************************************/
+/*!
+    @brief  Gets how many samples adaptive sampling has saved compared with
+            polling at the minimum interval over the same time
+    @returns The number of samples saved, 0 when not adaptive
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Engine::getSamplesSaved(void) {
+  if (!_maxInterval)
+    return 0;
+
+  uint32_t elapsed = Adafruit_TSL2561_Unified::clockMillis() - _adaptiveSince;
+  uint32_t fixed = elapsed / _minInterval;
+  return (fixed > _samples) ? fixed - _samples : 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sets the thresholds for TSL2561_EVENT_THRESHOLD. The event
+            fires whenever the level moves between below low, between the
+            two, and above high.
+    @param  low Lower threshold, in lux (counts with TSL2561_RAW_ONLY)
+    @param  high Upper threshold, in lux (counts with TSL2561_RAW_ONLY)
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Engine::setThresholds(uint32_t low, uint32_t high) {
+  _low = low;
+  _high = high;
+  _zone = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Starts a conversion when the interval has passed, or reads back
+            the one under way once it is done, and fires the events. Never
+            waits.
+    @returns True if a new reading was taken
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Engine::update(void) {
+  uint32_t now = Adafruit_TSL2561_Unified::clockMillis();
+  tsl2561Event_t event;
+
+  memset(&event, 0, sizeof(event));
+  event.sensor = _sensor;
+  event.timestamp = now;
+
+  if (!_converting) {
+    if (_started && ((now - _lastStart) < _interval))
+      return false;
+
+    _lastStart = now;
+    _started = true;
+#ifdef TSL2561_WITH_RETIMING
+    if (_planBudget)
+      _sensor->planTiming(_planBudget);
+#endif
+    if (_sensor->startConversion()) {
+      _converting = true;
+    } else {
+      dispatch(&event, TSL2561_EVENT_ERROR);
+    }
+    return false;
+  }
+
+  if (_sensor->getConversionTimeLeft() > 0)
+    return false;
+
+  _converting = false;
+  if (!_sensor->readConversion(&event.broadband, &event.ir)) {
+    dispatch(&event, TSL2561_EVENT_ERROR);
+    return false;
+  }
+
+#ifdef TSL2561_WITH_LUX
+  event.level = _sensor->calculateLux(event.broadband, event.ir);
+  bool saturated = (event.level == 65536);
+#else
+  event.level = event.broadband;
+  bool saturated = (event.broadband >
+                    clipThreshold(_sensor->currentIntegrationTime()));
+#endif
+
+  /* Speed up while the light changes, back off while it is steady */
+  if (_maxInterval) {
+    uint16_t delta = (event.broadband > _lastBroadband)
+                         ? event.broadband - _lastBroadband
+                         : _lastBroadband - event.broadband;
+    if (_samples && (delta > _change)) {
+      _interval = _minInterval;
+    } else if (_samples) {
+      _interval = (_interval > (_maxInterval >> 1)) ? _maxInterval
+                                                    : _interval << 1;
+    }
+  }
+  _lastBroadband = event.broadband;
+  _samples++;
+
+  /* Listeners may peek(), so the sample is cached before they run */
+  event.type = TSL2561_EVENT_SAMPLE;
+  _last = event;
+  _haveLast = true;
+  dispatch(&event, TSL2561_EVENT_SAMPLE);
+  if (saturated)
+    dispatch(&event, TSL2561_EVENT_SATURATED);
+
+  int8_t zone = (event.level < _low) ? -1 : (event.level > _high) ? 1 : 0;
+  if (zone != _zone) {
+    event.rising = (zone > _zone);
+    _zone = zone;
+    dispatch(&event, TSL2561_EVENT_THRESHOLD);
+  }
+
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the most recent sample taken by update(), without any bus
+            traffic
+    @param  sample Pointer to a tsl2561Event_t we will fill with the sample
+                   (type TSL2561_EVENT_SAMPLE, timestamp of the reading)
+    @param  maxAge Oldest sample to accept, in milliseconds
+    @returns False if there is no sample yet or it is older than maxAge
+             (sample is filled in either way once there is one)
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Engine::peek(tsl2561Event_t *sample, uint32_t maxAge) {
+  if (!_haveLast)
+    return false;
+
+  *sample = _last;
+  return getAge() <= maxAge;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gets the age of the most recent sample
+    @returns Milliseconds since it was read, or 0xFFFFFFFF if there is none
+*/
+/**************************************************************************/
+uint32_t Adafruit_TSL2561_Engine::getAge(void) {
+  if (!_haveLast)
+    return 0xFFFFFFFFUL;
+  return Adafruit_TSL2561_Unified::clockMillis() - _last.timestamp;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Subscribes a function to some of the events
+    @param  listener The function to call
+    @param  context Passed back to the function with each event
+    @param  events Mask of tsl2561EventType_t values to be told about
+    @returns False if all TSL2561_MAX_LISTENERS slots are taken
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Engine::subscribe(tsl2561Listener_t listener,
+                                        void *context, uint8_t events) {
+  for (uint8_t i = 0; i < TSL2561_MAX_LISTENERS; i++) {
+    if (!_listeners[i].listener) {
+      _listeners[i].listener = listener;
+      _listeners[i].context = context;
+      _listeners[i].events = events;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Unsubscribes a function
+    @param  listener The function given to subscribe()
+    @param  context The context given to subscribe()
+    @returns False if it wasn't subscribed
+*/
+/**************************************************************************/
+bool Adafruit_TSL2561_Engine::unsubscribe(tsl2561Listener_t listener,
+                                          void *context) {
+  for (uint8_t i = 0; i < TSL2561_MAX_LISTENERS; i++) {
+    if ((_listeners[i].listener == listener) &&
+        (_listeners[i].context == context)) {
+      _listeners[i].listener = NULL;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Tells every listener subscribed to an event about it
+    @param  event The event, type is filled in here
+    @param  type The event type
+*/
+/**************************************************************************/
+void Adafruit_TSL2561_Engine::dispatch(tsl2561Event_t *event,
+                                       tsl2561EventType_t type) {
+  event->type = type;
+  for (uint8_t i = 0; i < TSL2561_MAX_LISTENERS; i++) {
+    if (_listeners[i].listener && (_listeners[i].events & type)) {
+      _listeners[i].listener(event, _listeners[i].context);
+    }
+  }
 }
@@ -21,7 +21,26 @@
 #ifndef ADAFRUIT_TSL2561_H_
 #define ADAFRUIT_TSL2561_H_
 
+/* Build profiles: define any of these (e.g. in build flags) to leave out a
+   subsystem and save flash and RAM, or to add an optional one.
+   TSL2561_NO_AGC             Auto-gain loop in getLuminosity()
+   TSL2561_NO_UNIFIED_SENSOR  Adafruit_Sensor base class, getEvent() and
+                              getSensor()
+   TSL2561_RAW_ONLY           All lux math; only raw channel counts are
+                              available (implies TSL2561_NO_UNIFIED_SENSOR)
+   TSL2561_HEALTH_CHECK       Adds reset detection and recovery,
+                              checkHealth() (off by default)
+   TSL2561_FOLD_TIMING        Powers up and sets TIMING in one word write
+                              (off by default, not yet checked on hardware)
+   TSL2561_PACKAGE_CS below selects the package's lux coefficients; only
+   those of the packages in use are linked. */
+#if defined(TSL2561_RAW_ONLY) && !defined(TSL2561_NO_UNIFIED_SENSOR)
+#define TSL2561_NO_UNIFIED_SENSOR
+#endif
+
+#ifndef TSL2561_NO_UNIFIED_SENSOR
 #include <Adafruit_Sensor.h>
+#endif
 #include <Arduino.h>
 #include <Wire.h>
 
@@ -36,7 +55,9 @@
 
 // Lux calculations differ slightly for CS package
 //#define TSL2561_PACKAGE_CS                ///< Chip scale package
+#ifndef TSL2561_PACKAGE_CS
 #define TSL2561_PACKAGE_T_FN_CL ///< Dual Flat No-Lead package
+#endif
 
 #define TSL2561_COMMAND_BIT (0x80) ///< Must be 1
 #define TSL2561_CLEAR_BIT                                                      \
@@ -48,6 +69,9 @@
 #define TSL2561_CONTROL_POWEROFF                                               \
   (0x00) ///< Control register setting to turn off
 
+#define TSL2561_ID_PARTNO_CS (0x1)      ///< ID register PARTNO, TSL2561CS
+#define TSL2561_ID_PARTNO_T_FN_CL (0x5) ///< ID register PARTNO, TSL2561T/FN/CL
+
 #define TSL2561_LUX_LUXSCALE (14)          ///< Scale by 2^14
 #define TSL2561_LUX_RATIOSCALE (9)         ///< Scale ratio by 2^9
 #define TSL2561_LUX_CHSCALE (10)           ///< Scale channel values by 2^10
@@ -126,6 +150,138 @@
 #define TSL2561_DELAY_INTTIME_13MS (15)   ///< Wait 15ms for 13ms integration
 #define TSL2561_DELAY_INTTIME_101MS (120) ///< Wait 120ms for 101ms integration
 #define TSL2561_DELAY_INTTIME_402MS (450) ///< Wait 450ms for 402ms integration
+#define TSL2561_DELAY_CONVERSION_BUS                                           \
+  (2) ///< Bus time for the power-up, reads and power-down of a conversion
+
+// HDR acquisition
+#define TSL2561_HDR_BUDGET_DEFAULT                                             \
+  (TSL2561_DELAY_INTTIME_13MS + TSL2561_DELAY_INTTIME_402MS +                  \
+   2 * TSL2561_DELAY_CONVERSION_BUS) ///< Short + longest exposure, in ms
+
+/* Build-time configuration: define any of these (e.g. in build flags) to fix
+   a setting at compile time. The member holding it is dropped and the
+   lookups that depend on it fold into constants.
+   TSL2561_FIXED_ADDR             I2C address, e.g. TSL2561_ADDR_FLOAT
+   TSL2561_FIXED_INTEGRATIONTIME  e.g. TSL2561_INTEGRATIONTIME_402MS
+   TSL2561_FIXED_GAIN             e.g. TSL2561_GAIN_16X
+   With a fixed integration time or gain, saturation recovery,
+   getLuxWithin() and getLuxHDR() are not available; auto-gain only goes
+   with a fixed gain. These apply to every sensor in the build, and every
+   file in it must see the same ones: for a sensor whose settings are known
+   at compile time, Adafruit_TSL2561_Fixed below keeps them per sensor. */
+#if defined(TSL2561_FIXED_INTEGRATIONTIME) || defined(TSL2561_FIXED_GAIN)
+#define TSL2561_FIXED_TIMING ///< Timing register can't change at runtime
+#endif
+
+/* Features left in the build, derived from the switches above */
+#ifndef TSL2561_RAW_ONLY
+#define TSL2561_WITH_LUX ///< Lux conversion
+#endif
+#if !defined(TSL2561_FIXED_GAIN) && !defined(TSL2561_NO_AGC)
+#define TSL2561_WITH_AGC ///< Auto-gain
+#endif
+#if !defined(TSL2561_FIXED_TIMING) && defined(TSL2561_WITH_LUX)
+#define TSL2561_WITH_RETIMING ///< HDR, time budget and saturation recovery
+#endif
+#ifdef TSL2561_HEALTH_CHECK
+#define TSL2561_WITH_HEALTH ///< Reset detection and recovery
+#endif
+/* 8-bit AVRs have one core and no 32-bit atomic loads and stores */
+#ifndef __AVR__
+#define TSL2561_WITH_SHARED_SAMPLES ///< Adafruit_TSL2561_BusWorker
+#endif
+
+/* Link-time check of the switches that change Adafruit_TSL2561_Unified's
+   layout. The library defines one symbol whose name spells out the
+   switches it was built with, and every sensor construction references
+   the one spelled out by the file constructing it, so a file built with
+   other switches fails to link (undefined reference to tsl2561_profile_...)
+   instead of disagreeing with the library about the class. The name has
+   one bit per switch: Adafruit_Sensor base (u), lux (l), health checks (h),
+   fixed address (a), integration time (t) and gain (g), bus lock (k) and
+   energy accounting (e). */
+#ifdef TSL2561_NO_UNIFIED_SENSOR
+#define TSL2561_PROFILE_UNIFIED 0 ///< Profile bit: Adafruit_Sensor base
+#else
+#define TSL2561_PROFILE_UNIFIED 1 ///< Profile bit: Adafruit_Sensor base
+#endif
+#ifdef TSL2561_WITH_LUX
+#define TSL2561_PROFILE_LUX 1 ///< Profile bit: lux conversion
+#else
+#define TSL2561_PROFILE_LUX 0 ///< Profile bit: lux conversion
+#endif
+#ifdef TSL2561_WITH_HEALTH
+#define TSL2561_PROFILE_HEALTH 1 ///< Profile bit: reset detection
+#else
+#define TSL2561_PROFILE_HEALTH 0 ///< Profile bit: reset detection
+#endif
+#ifdef TSL2561_FIXED_ADDR
+#define TSL2561_PROFILE_ADDR 1 ///< Profile bit: TSL2561_FIXED_ADDR
+#else
+#define TSL2561_PROFILE_ADDR 0 ///< Profile bit: TSL2561_FIXED_ADDR
+#endif
+#ifdef TSL2561_FIXED_INTEGRATIONTIME
+#define TSL2561_PROFILE_TIME 1 ///< Profile bit: fixed integration time
+#else
+#define TSL2561_PROFILE_TIME 0 ///< Profile bit: fixed integration time
+#endif
+#ifdef TSL2561_FIXED_GAIN
+#define TSL2561_PROFILE_GAIN 1 ///< Profile bit: TSL2561_FIXED_GAIN
+#else
+#define TSL2561_PROFILE_GAIN 0 ///< Profile bit: TSL2561_FIXED_GAIN
+#endif
+#ifdef TSL2561_BUS_LOCK
+#define TSL2561_PROFILE_LOCK 1 ///< Profile bit: TSL2561_BUS_LOCK
+#else
+#define TSL2561_PROFILE_LOCK 0 ///< Profile bit: TSL2561_BUS_LOCK
+#endif
+#ifdef TSL2561_ENERGY
+#define TSL2561_PROFILE_ENERGY 1 ///< Profile bit: TSL2561_ENERGY
+#else
+#define TSL2561_PROFILE_ENERGY 0 ///< Profile bit: TSL2561_ENERGY
+#endif
+/** Pastes the profile bits into a symbol name */
+#define TSL2561_PROFILE_PASTE(u, l, h, a, t, g, k, e)                          \
+  tsl2561_profile_u##u##_l##l##_h##h##_a##a##_t##t##_g##g##_k##k##_e##e
+/** Expands the profile bits before pasting them */
+#define TSL2561_PROFILE_NAME(u, l, h, a, t, g, k, e)                           \
+  TSL2561_PROFILE_PASTE(u, l, h, a, t, g, k, e)
+/** The build profile symbol for the switches this file sees */
+#define TSL2561_PROFILE                                                        \
+  TSL2561_PROFILE_NAME(TSL2561_PROFILE_UNIFIED, TSL2561_PROFILE_LUX,           \
+                       TSL2561_PROFILE_HEALTH, TSL2561_PROFILE_ADDR,           \
+                       TSL2561_PROFILE_TIME, TSL2561_PROFILE_GAIN,             \
+                       TSL2561_PROFILE_LOCK, TSL2561_PROFILE_ENERGY)
+extern const uint8_t TSL2561_PROFILE; ///< Defined by the library's own build
+#ifdef __GNUC__
+/** Takes the address of this file's profile symbol in an asm statement the
+    optimiser must keep, so the reference survives --gc-sections and LTO
+    without a memory access */
+#define TSL2561_REQUIRE_PROFILE()                                              \
+  __asm__ __volatile__("" : : "r"(&TSL2561_PROFILE))
+#else
+/** References this file's profile symbol with a read that can't be dropped */
+#define TSL2561_REQUIRE_PROFILE()                                              \
+  (void)*(const volatile uint8_t *)&TSL2561_PROFILE
+#endif
+
+/* Supply currents used for the TSL2561_ENERGY estimate, typical values from
+   the datasheet; override them for a characterised part */
+#ifndef TSL2561_SUPPLY_ACTIVE_UA
+#define TSL2561_SUPPLY_ACTIVE_UA (240.0f) ///< Supply current when powered
+#endif
+#ifndef TSL2561_SUPPLY_POWERDOWN_UA
+#define TSL2561_SUPPLY_POWERDOWN_UA (3.2f) ///< Supply current when powered down
+#endif
+
+/* readAsync() needs C++20 coroutines, e.g. -std=gnu++20 on a host or a
+   recent ESP32 core */
+#if defined(__cplusplus) && (__cplusplus >= 202002L) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define TSL2561_WITH_COROUTINES ///< co_await readAsync()
+#endif
+#endif
 
 /** TSL2561 I2C Registers */
 enum {
@@ -158,46 +314,1008 @@ typedef enum {
   TSL2561_GAIN_16X = 0x10, // 16x gain
 } tsl2561Gain_t;
 
+/** The two packages, whose lux coefficients differ */
+typedef enum {
+  TSL2561_PACKAGE_TYPE_T_FN_CL, // T, FN and CL packages
+  TSL2561_PACKAGE_TYPE_CS,      // Chip scale package
+} tsl2561Package_t;
+
+#ifdef TSL2561_PACKAGE_CS
+#define TSL2561_PACKAGE_TYPE TSL2561_PACKAGE_TYPE_CS ///< The build's package
+#else
+#define TSL2561_PACKAGE_TYPE                                                   \
+  TSL2561_PACKAGE_TYPE_T_FN_CL ///< The build's package
+#endif
+
+/** A single reading with the settings and quality flags it was taken with */
+typedef struct {
+  uint16_t broadband;            ///< Raw channel 0 (visible + IR) counts
+  uint16_t ir;                   ///< Raw channel 1 (IR) counts
+  uint32_t milliLux;             ///< Lux in thousandths of a lux
+  uint32_t uncertainty;          ///< Estimated uncertainty in milli-lux
+  uint8_t segment;               ///< Ratio segment (1-8), 0 if saturated
+  tsl2561Gain_t gain;            ///< Gain the reading was taken with
+  tsl2561IntegrationTime_t time; ///< Integration time of the reading
+  bool saturated;                ///< Either channel was clipped
+  bool agcAdjusted;              ///< Auto-gain changed the gain
+} tsl2561Reading_t;
+
+/** Time source used for timestamps and conversion waits */
+typedef struct {
+  uint32_t (*millis)(void);   ///< Returns milliseconds since start
+  void (*delay)(uint32_t ms); ///< Waits for (or advances time by) ms
+  uint32_t (*micros)(void);   ///< Microseconds since start, or NULL to use
+                              ///< millis() * 1000
+} tsl2561Clock_t;
+
+/** A time limit a call's transactions and retries must keep to, passed down
+    from the call on its stack */
+typedef struct {
+  uint32_t start;  ///< clockMillis() when the call started
+  uint32_t budget; ///< Milliseconds from start the call may take
+} tsl2561Deadline_t;
+
+#ifdef TSL2561_BUS_TRACE
+/** One register transaction, as seen by the bus recorder and replay hooks */
+typedef struct {
+  uint32_t timestamp;   ///< clockMillis() when the transaction started
+  uint32_t duration_us; ///< Time spent on the bus, from clockMicros()
+  uint8_t addr;         ///< I2C address of the sensor
+  uint8_t reg;          ///< Command byte (register and command bits)
+  uint8_t len;          ///< Number of data bytes written or read
+  bool read;            ///< True for a register read, false for a write
+  bool ok;              ///< False if the transaction failed on the bus
+  uint16_t value;       ///< Value written, or value read back
+} tsl2561BusRecord_t;
+
+/** Called after every transaction, e.g. to capture it */
+typedef void (*tsl2561BusRecorder_t)(const tsl2561BusRecord_t *record);
+
+/** Called before every transaction; return true to serve it from a capture
+    (filling in value for reads, and clearing ok to fail it) instead of the
+    bus */
+typedef bool (*tsl2561BusReplay_t)(tsl2561BusRecord_t *record);
+#endif
+
+#ifdef TSL2561_BUS_LOCK
+/** Lock taken around every bus transaction when built with
+    TSL2561_BUS_LOCK, usually set up by Adafruit_TSL2561_Locked */
+typedef struct {
+  void *mutex;                 ///< Passed to lock() and unlock()
+  void (*lock)(void *mutex);   ///< Takes the bus
+  void (*unlock)(void *mutex); ///< Releases the bus
+} tsl2561BusLock_t;
+#endif
+
+#ifdef TSL2561_ENERGY
+/** Power and bus activity of one sensor, from getEnergy() */
+typedef struct {
+  uint32_t elapsed_ms;       ///< Time covered, since construction or reset
+  uint32_t onTime_ms;        ///< Time spent at TSL2561_CONTROL_POWERON
+  uint32_t powerTransitions; ///< Power-ups plus power-downs
+  uint32_t busBytes;         ///< Bytes on the bus, address bytes included
+  float charge_uAh;          ///< Estimated charge drawn by the sensor
+} tsl2561Energy_t;
+#endif
+
+#ifdef TSL2561_WITH_COROUTINES
+class Adafruit_TSL2561_Unified;
+
+/**************************************************************************/
+/*!
+    @brief  Resumes coroutines suspended in readAsync(), e.g. from a timer
+            list polled in the main loop or a timer interrupt. Implemented
+            by the application (see the coroutines example).
+*/
+/**************************************************************************/
+class Adafruit_TSL2561_Scheduler {
+public:
+  /*!
+      @brief  Asks for a coroutine to be resumed once a conversion is done
+      @param  handle The coroutine to resume
+      @param  when clockMillis() value from which it may be resumed
+      @returns True if it will be resumed, false if it can't be queued; the
+               coroutine then carries on straight away. Never resume it
+               from inside this call.
+  */
+  virtual bool resumeAt(std::coroutine_handle<> handle, uint32_t when) = 0;
+};
+
+/**************************************************************************/
+/*!
+    @brief  Awaitable returned by readAsync(). Starts the conversion when
+            awaited, suspends for the integration time, and reads both
+            channels on resumption. co_await gives true if both were read.
+*/
+/**************************************************************************/
+class Adafruit_TSL2561_ReadAwaiter {
+public:
+  /*!
+      @brief  Constructor, see readAsync()
+      @param  sensor The sensor to read
+      @param  scheduler Resumes the awaiting coroutine
+      @param  broadband Filled with the broadband reading
+      @param  ir Filled with the IR reading
+  */
+  Adafruit_TSL2561_ReadAwaiter(Adafruit_TSL2561_Unified *sensor,
+                               Adafruit_TSL2561_Scheduler *scheduler,
+                               uint16_t *broadband, uint16_t *ir)
+      : _sensor(sensor), _scheduler(scheduler), _broadband(broadband),
+        _ir(ir), _started(false) {}
+
+  bool await_ready(void);
+  bool await_suspend(std::coroutine_handle<> handle);
+  bool await_resume(void);
+
+private:
+  Adafruit_TSL2561_Unified *_sensor;
+  Adafruit_TSL2561_Scheduler *_scheduler;
+  uint16_t *_broadband;
+  uint16_t *_ir;
+  bool _started;
+};
+#endif
+
+/* Upper bound on sizeof(Adafruit_TSL2561_Unified), checked at compile time
+   so that new members are a deliberate choice. Two pointers (vtable and
+   bus, plus the lock with TSL2561_BUS_LOCK) and the packed state, then
+   what the opt-in features add, rounded up to the pointer alignment the
+   compiler pads the class to. With the default switches that is the size
+   of the driver before any of them existed, 32 bytes on a 64-bit host:
+   nothing a sketch doesn't ask for may cost it RAM. */
+#define TSL2561_STATE_BUDGET                                                   \
+  (16) ///< Settings, flags, error count, light level and conversion start
+#ifdef TSL2561_WITH_HEALTH
+#define TSL2561_HEALTH_BUDGET                                                  \
+  (9) ///< Reset detection: fault start, recovery time and count, interval
+#else
+#define TSL2561_HEALTH_BUDGET (0) ///< Health checks are left out
+#endif
+#ifdef TSL2561_ENERGY
+#define TSL2561_ENERGY_BUDGET (20) ///< Five 32-bit energy counters
+#else
+#define TSL2561_ENERGY_BUDGET (0) ///< Energy accounting is left out
+#endif
+#ifdef TSL2561_BUS_LOCK
+#define TSL2561_POINTER_BUDGET (3 * sizeof(void *)) ///< vtable, bus and lock
+#else
+#define TSL2561_POINTER_BUDGET (2 * sizeof(void *)) ///< vtable and bus
+#endif
+#define TSL2561_RAM_BUDGET                                                     \
+  ((TSL2561_POINTER_BUDGET + TSL2561_STATE_BUDGET + TSL2561_HEALTH_BUDGET +    \
+    TSL2561_ENERGY_BUDGET + sizeof(void *) - 1) /                              \
+   sizeof(void *) * sizeof(void *)) ///< Bytes per sensor instance, at most
+
 /**************************************************************************/
 /*!
     @brief  Class that stores state and functions for interacting with TSL2561
    Light Sensor
 */
 /**************************************************************************/
+#ifdef TSL2561_NO_UNIFIED_SENSOR
+class Adafruit_TSL2561_Unified {
+#else
 class Adafruit_TSL2561_Unified : public Adafruit_Sensor {
+#endif
 public:
-  Adafruit_TSL2561_Unified(uint8_t addr, int32_t sensorID = -1);
+  /*!
+      @brief Constructor. Always inlined, so that the file constructing the
+             sensor references its own build profile (see TSL2561_PROFILE)
+      @param addr The I2C address this chip can be found on, 0x29, 0x39 or
+                  0x49 (ignored when built with TSL2561_FIXED_ADDR, and set
+                  by discover())
+      @param sensorID An optional ID that will be placed in sensor events to
+                      help keep track if you have many sensors in use
+  */
+  __attribute__((always_inline))
+  Adafruit_TSL2561_Unified(uint8_t addr = TSL2561_ADDR_FLOAT,
+                           int32_t sensorID = -1) {
+    TSL2561_REQUIRE_PROFILE();
+    construct(addr, sensorID);
+  }
   boolean begin(void);
   boolean begin(TwoWire *theWire);
   boolean init();
 
+  /* Discovery Functions */
+  static uint8_t discover(TwoWire *const *buses, uint8_t busCount,
+                          Adafruit_TSL2561_Unified *sensors,
+                          uint8_t maxSensors);
+  static uint8_t discover(TwoWire *bus, Adafruit_TSL2561_Unified *sensors,
+                          uint8_t maxSensors);
+
   /* TSL2561 Functions */
   void enableAutoRange(bool enable);
   void setIntegrationTime(tsl2561IntegrationTime_t time);
   void setGain(tsl2561Gain_t gain);
   void getLuminosity(uint16_t *broadband, uint16_t *ir);
+
+  /* Non-blocking Conversion Functions */
+  bool startConversion(void);
+  uint32_t getConversionTimeLeft(void);
+  bool readConversion(uint16_t *broadband, uint16_t *ir);
+#ifdef TSL2561_WITH_COROUTINES
+  Adafruit_TSL2561_ReadAwaiter readAsync(Adafruit_TSL2561_Scheduler *scheduler,
+                                         uint16_t *broadband, uint16_t *ir);
+#endif
+
+#ifdef TSL2561_WITH_LUX
   uint32_t calculateLux(uint16_t broadband, uint16_t ir);
+  static uint32_t calculateLux(uint16_t broadband, uint16_t ir,
+                               tsl2561IntegrationTime_t time,
+                               tsl2561Gain_t gain);
+  uint32_t calculateLuxQ(uint16_t broadband, uint16_t ir);
+  void enableSubLux(bool enable);
+  bool getReading(tsl2561Reading_t *reading);
+#endif
+
+#ifdef TSL2561_WITH_RETIMING
+  void enableSaturationRecovery(bool enable);
+  uint8_t getSaturationRetries(void);
+
+  /* Time-budgeted acquisition */
+  boolean getLuxWithin(uint32_t budget_ms, uint32_t *lux,
+                       uint32_t *precision);
+
+  /* HDR (bracketed exposure) Functions */
+  boolean getLuxHDR(uint32_t *lux,
+                    uint16_t budget_ms = TSL2561_HDR_BUDGET_DEFAULT);
+#endif
+
+  /* Clock Functions */
+  static void setClock(const tsl2561Clock_t *clock);
+  static uint32_t clockMillis(void);
+  static uint32_t clockMicros(void);
+  static void clockDelay(uint32_t ms);
+
+  /* Bus Error Functions */
+  static void setBusRetries(uint8_t retries, uint8_t backoff_ms);
+  uint16_t getI2CErrorCount(void);
+  bool getBusFault(void);
+
+#ifdef TSL2561_WITH_HEALTH
+  /* Reset Detection Functions */
+  void setHealthCheckInterval(uint8_t readings);
+  bool checkHealth(void);
+  uint8_t getRecoveryCount(void);
+  uint16_t getLastRecoveryTime(void);
+#endif
+
+#ifdef TSL2561_BUS_LOCK
+  void setBusLock(const tsl2561BusLock_t *lock);
+#endif
+
+#ifdef TSL2561_ENERGY
+  /* Energy accounting */
+  void getEnergy(tsl2561Energy_t *energy);
+  void resetEnergy(void);
+#endif
 
+#ifdef TSL2561_BUS_TRACE
+  /* Bus record and replay */
+  static void setBusRecorder(tsl2561BusRecorder_t recorder);
+  static void setBusReplay(tsl2561BusReplay_t replay);
+  static uint32_t getBusTransactionCount(void);
+#endif
+
+#ifndef TSL2561_NO_UNIFIED_SENSOR
   /* Unified Sensor API Functions */
   bool getEvent(sensors_event_t *);
   void getSensor(sensor_t *);
+#endif
 
 private:
+  friend class Adafruit_TSL2561_Engine;
+  friend class Adafruit_TSL2561_Mux;
+  template <uint8_t, tsl2561IntegrationTime_t, tsl2561Gain_t,
+            tsl2561Package_t>
+  friend class Adafruit_TSL2561_Fixed;
+
+  void construct(uint8_t addr, int32_t sensorID);
+
   TwoWire *_i2c;
+#ifdef TSL2561_BUS_LOCK
+  const tsl2561BusLock_t *_busLock;
+#endif
 
+#ifndef TSL2561_FIXED_ADDR
   int8_t _addr;
-  boolean _tsl2561Initialised;
-  boolean _tsl2561AutoGain;
-  tsl2561IntegrationTime_t _tsl2561IntegrationTime;
-  tsl2561Gain_t _tsl2561Gain;
+#endif
+#if !defined(TSL2561_FIXED_INTEGRATIONTIME) || !defined(TSL2561_FIXED_GAIN)
+  uint8_t _tsl2561Timing; ///< TIMING register image: integration time | gain
+#endif
+  bool _tsl2561Initialised : 1;
+  bool _tsl2561AutoGain : 1;
+  bool _tsl2561AGCFired : 1;
+  bool _tsl2561BusFault : 1;
+  bool _tsl2561Converting : 1;
+#ifdef TSL2561_WITH_HEALTH
+  bool _tsl2561Recovering : 1;
+#endif
+#ifdef TSL2561_WITH_LUX
+  bool _tsl2561SubLux : 1;
+#endif
+#ifdef TSL2561_WITH_RETIMING
+  bool _tsl2561SatRecovery : 1;
+  uint8_t _tsl2561SatRetries : 2;
+  bool _tsl2561TimingDirty : 1; ///< _tsl2561Timing not yet on the device
+#endif
+#ifdef TSL2561_ENERGY
+  bool _tsl2561Powered : 1;
+#endif
+  uint16_t _tsl2561I2CErrors;
+#ifdef TSL2561_WITH_RETIMING
+  uint16_t _tsl2561LastLevel; ///< Light level, see TSL2561_LEVEL_SHIFT
+#endif
+  uint32_t _tsl2561ConvStart; ///< clockMillis() when the conversion started
+#ifndef TSL2561_NO_UNIFIED_SENSOR
   int32_t _tsl2561SensorID;
+#endif
+#ifdef TSL2561_WITH_HEALTH
+  uint32_t _tsl2561FaultSince;
+  uint16_t _tsl2561RecoveryTime;
+  uint8_t _tsl2561HealthInterval;
+  uint8_t _tsl2561HealthCount;
+  uint8_t _tsl2561Recoveries;
+#endif
+#ifdef TSL2561_ENERGY
+  uint32_t _tsl2561EnergySince;
+  uint32_t _tsl2561PoweredAt;
+  uint32_t _tsl2561OnTime;
+  uint32_t _tsl2561PowerTransitions;
+  uint32_t _tsl2561BusBytes;
+#endif
+
+  /* Settings, from the members or the build-time configuration */
+  uint8_t address(void) const {
+#ifdef TSL2561_FIXED_ADDR
+    return TSL2561_FIXED_ADDR;
+#else
+    return _addr;
+#endif
+  }
+  tsl2561IntegrationTime_t currentIntegrationTime(void) const {
+#ifdef TSL2561_FIXED_INTEGRATIONTIME
+    return TSL2561_FIXED_INTEGRATIONTIME;
+#else
+    return (tsl2561IntegrationTime_t)(_tsl2561Timing & 0x03);
+#endif
+  }
+  tsl2561Gain_t currentGain(void) const {
+#ifdef TSL2561_FIXED_GAIN
+    return TSL2561_FIXED_GAIN;
+#else
+    return (tsl2561Gain_t)(_tsl2561Timing & TSL2561_GAIN_16X);
+#endif
+  }
+
+  bool enable(const tsl2561Deadline_t *deadline = NULL);
+  bool disable(const tsl2561Deadline_t *deadline = NULL);
+  bool write8(uint8_t reg, uint8_t value,
+              const tsl2561Deadline_t *deadline = NULL);
+#if defined(TSL2561_WITH_RETIMING) && defined(TSL2561_FOLD_TIMING)
+  bool write16(uint8_t reg, uint16_t value,
+               const tsl2561Deadline_t *deadline = NULL);
+#endif
+  bool read8(uint8_t reg, uint8_t *value,
+             const tsl2561Deadline_t *deadline = NULL);
+  bool read16(uint8_t reg, uint16_t *value,
+              const tsl2561Deadline_t *deadline = NULL);
+  bool readBlock(uint8_t reg, uint8_t *buffer, uint8_t len,
+                 const tsl2561Deadline_t *deadline = NULL);
+  bool writeOnce(uint8_t reg, uint16_t value, uint8_t len);
+  bool readOnce(uint8_t reg, uint8_t *buffer, uint8_t len);
+  bool retryAfterError(uint8_t attempt, const tsl2561Deadline_t *deadline);
+  static bool busWrite(TwoWire *bus, uint8_t addr, uint8_t reg,
+                       uint16_t value, uint8_t len);
+  static bool busRead(TwoWire *bus, uint8_t addr, uint8_t reg,
+                      uint8_t *buffer, uint8_t len);
+  static bool retryWait(uint8_t attempt, const tsl2561Deadline_t *deadline);
+#ifdef TSL2561_ENERGY
+  void noteTransfer(uint8_t reg, uint8_t len, bool read, uint8_t value,
+                    bool ok);
+#endif
+#ifdef TSL2561_BUS_LOCK
+  void lockBus(void) {
+    if (_busLock)
+      _busLock->lock(_busLock->mutex);
+  }
+  void unlockBus(void) {
+    if (_busLock)
+      _busLock->unlock(_busLock->mutex);
+  }
+#endif
+  static const tsl2561Clock_t *_clock;
+  static uint8_t _busRetries;
+  static uint8_t _busBackoff;
+#ifdef TSL2561_BUS_TRACE
+  static tsl2561BusRecorder_t _busRecorder;
+  static tsl2561BusReplay_t _busReplay;
+  static uint32_t _busTransactions;
+  bool traceBegin(tsl2561BusRecord_t *record, uint8_t reg, uint8_t len,
+                  bool read, uint16_t value);
+  void traceEnd(tsl2561BusRecord_t *record, uint16_t value, bool ok);
+#endif
+  bool beginWithin(const tsl2561Deadline_t *deadline);
+  bool initWithin(const tsl2561Deadline_t *deadline);
+  bool getData(uint16_t *broadband, uint16_t *ir);
+  bool powerUp(const tsl2561Deadline_t *deadline = NULL);
+  void stopConversion(const tsl2561Deadline_t *deadline = NULL);
+  bool readConversionWithin(uint16_t *broadband, uint16_t *ir,
+                            const tsl2561Deadline_t *deadline);
+  bool setTiming(tsl2561IntegrationTime_t time, tsl2561Gain_t gain,
+                 const tsl2561Deadline_t *deadline = NULL);
+  bool probe(bool retry = false, const tsl2561Deadline_t *deadline = NULL);
+#ifdef TSL2561_WITH_HEALTH
+  bool checkHealthWithin(const tsl2561Deadline_t *deadline);
+  void noteFault(void);
+#endif
+#ifdef TSL2561_WITH_RETIMING
+  int8_t choosePlan(uint32_t budget_ms);
+  void planTiming(uint32_t budget_ms);
+  uint32_t recoverSaturation(uint16_t *broadband, uint16_t *ir,
+                             tsl2561IntegrationTime_t *usedTime,
+                             tsl2561Gain_t *usedGain);
+  bool exposeWithin(uint8_t timing, uint16_t *broadband, uint16_t *ir,
+                    const tsl2561Deadline_t *deadline);
+  bool mergeHDR(uint32_t *lux, const tsl2561Deadline_t *deadline);
+#endif
+#ifdef TSL2561_WITH_LUX
+  static uint32_t calculateLuxScaled(uint16_t broadband, uint16_t ir,
+                                     tsl2561IntegrationTime_t time,
+                                     tsl2561Gain_t gain,
+                                     uint8_t *segment = NULL);
+  template <tsl2561Package_t Package>
+  static uint32_t luxFromChannels(unsigned long channel0,
+                                  unsigned long channel1,
+                                  uint8_t *segment = NULL);
+  static uint32_t luxResolution(uint16_t broadband, uint16_t ir,
+                                tsl2561IntegrationTime_t time,
+                                tsl2561Gain_t gain);
+#endif
+};
+
+#ifdef TSL2561_BUS_TRACE
+#define TSL2561_CAPTURE_RESYNC                                                 \
+  (8) ///< Records a replay looks ahead to find a request that moved
+
+/**************************************************************************/
+/*!
+    @brief  Reference recorder and replayer for the bus trace hooks.
+            record() captures every register transaction into a buffer the
+            caller provides. replay() then serves those transactions back
+            in place of the bus, e.g. to a new build of the driver, and
+            keeps track of where its requests stopped matching the capture.
+            The hooks are shared by all sensors, so only one capture can be
+            recording or replaying at a time.
+*/
+/**************************************************************************/
+class Adafruit_TSL2561_BusCapture {
+public:
+  Adafruit_TSL2561_BusCapture(tsl2561BusRecord_t *records, uint16_t capacity);
+
+  void record(void);
+  void replay(uint16_t count);
+  void stop(void);
+
+  uint16_t getCount(void);
+  bool getOverflow(void);
+  int32_t getDivergence(void);
+  uint16_t getAdded(void);
+  uint16_t getDropped(void);
+  int32_t getTransactionDiff(void);
+
+private:
+  static void recordHook(const tsl2561BusRecord_t *record);
+  static bool replayHook(tsl2561BusRecord_t *record);
+  static bool matches(const tsl2561BusRecord_t *captured,
+                      const tsl2561BusRecord_t *request);
+  void serve(tsl2561BusRecord_t *request);
+  void shadow(const tsl2561BusRecord_t *record);
+
+  static Adafruit_TSL2561_BusCapture *_active;
+  tsl2561BusRecord_t *_records;
+  uint16_t _capacity;
+  uint16_t _count;
+  uint16_t _position; ///< Next record to serve
+  uint16_t _requests; ///< Transactions asked for during replay
+  uint16_t _added;    ///< Requests that weren't in the capture
+  uint16_t _skipped;  ///< Records passed over to resync
+  int32_t _divergence;
+  uint8_t _shadow[16]; ///< Register values seen during replay
+  uint16_t _known;     ///< Registers with a value in _shadow, one bit each
+  bool _overflow;
+};
+#endif
+
+#define TSL2561_MUX_ADDR (0x70)  ///< TCA9548A address with A0-A2 low
+#define TSL2561_MUX_CHANNELS (8) ///< Downstream channels on a TCA9548A
+#define TSL2561_MUX_NONE (0xFF)  ///< No channel selected, or not known
+
+/** A sensor behind a mux channel, and what the last scan read from it */
+typedef struct {
+  Adafruit_TSL2561_Unified *sensor; ///< Sensor, begun on the mux's bus
+  uint8_t channel;                  ///< Mux channel the sensor is on (0-7)
+  uint16_t broadband;               ///< Last broadband reading
+  uint16_t ir;                      ///< Last IR reading
+  bool valid;                       ///< True if the last scan read the sensor
+} tsl2561MuxSlot_t;
+
+/**************************************************************************/
+/*!
+    @brief  TCA9548A-style I2C mux in front of a bus, and a scheduler for
+            the sensors behind it that keeps channel switches to a minimum
+*/
+/**************************************************************************/
+class Adafruit_TSL2561_Mux {
+public:
+  Adafruit_TSL2561_Mux(TwoWire *bus, uint8_t addr = TSL2561_MUX_ADDR);
+
+  bool select(uint8_t channel);
+  void invalidate(void);
+  uint16_t getSelectCount(void);
+
+  /* Batched acquisition */
+  uint8_t startAll(tsl2561MuxSlot_t *slots, uint8_t count);
+  uint8_t readAll(tsl2561MuxSlot_t *slots, uint8_t count);
+  uint8_t scan(tsl2561MuxSlot_t *slots, uint8_t count);
+
+private:
+  TwoWire *_bus;
+  uint8_t _addr;
+  uint8_t _channel; ///< Channel the mux is known to be on
+  uint16_t _selects;
+};
+
+#ifdef TSL2561_WITH_SHARED_SAMPLES
+/** A sample shared between the task that acquires it and any number of
+    readers, without locks. Written with publish() and read with
+    readShared() from Adafruit_TSL2561_BusWorker. Every field is only
+    accessed atomically. */
+typedef struct {
+  uint32_t sequence;  ///< Odd while being written; too wide to wrap unseen
+  bool valid;         ///< False if the last read failed
+  uint16_t broadband; ///< Broadband reading
+  uint16_t ir;        ///< IR reading
+  uint32_t timestamp; ///< clockMillis() when the sample was read
+} tsl2561SharedSample_t;
+
+/**************************************************************************/
+/*!
+    @brief  Acquires from every sensor on one bus and publishes the results
+            into shared samples. Run one worker per bus, each from its own
+            task, core or thread, e.g. `for (;;) worker.run();`
+*/
+/**************************************************************************/
+class Adafruit_TSL2561_BusWorker {
+public:
+  Adafruit_TSL2561_BusWorker(Adafruit_TSL2561_Unified *const *sensors,
+                             tsl2561SharedSample_t *samples, uint8_t count);
+
+  uint8_t run(void);
+  uint32_t getRounds(void);
+
+  static void publish(tsl2561SharedSample_t *sample, bool valid,
+                      uint16_t broadband, uint16_t ir, uint32_t timestamp);
+  static bool readShared(const tsl2561SharedSample_t *sample,
+                         uint16_t *broadband, uint16_t *ir,
+                         uint32_t *timestamp);
+
+private:
+  Adafruit_TSL2561_Unified *const *_sensors;
+  tsl2561SharedSample_t *_samples;
+  uint8_t _count;
+  uint32_t _rounds;
+};
+#endif
+
+/** Events fired by Adafruit_TSL2561_Engine, also used as a mask */
+typedef enum {
+  TSL2561_EVENT_SAMPLE = 0x01,    ///< A new reading was taken
+  TSL2561_EVENT_THRESHOLD = 0x02, ///< The level crossed a threshold
+  TSL2561_EVENT_SATURATED = 0x04, ///< A reading clipped
+  TSL2561_EVENT_ERROR = 0x08,     ///< A conversion failed on the bus
+  TSL2561_EVENT_ALL = 0x0F        ///< Every event
+} tsl2561EventType_t;
+
+/** What a listener is told */
+typedef struct {
+  tsl2561EventType_t type;          ///< Which event this is
+  Adafruit_TSL2561_Unified *sensor; ///< The sensor it came from
+  uint16_t broadband;               ///< Broadband reading (0 on error)
+  uint16_t ir;                      ///< IR reading (0 on error)
+  uint32_t level; ///< Lux, or broadband counts with TSL2561_RAW_ONLY
+  bool rising;    ///< For thresholds, true if the level went up across it
+  uint32_t timestamp; ///< clockMillis() when the reading was taken
+} tsl2561Event_t;
+
+/** Called with each event a listener subscribed to */
+typedef void (*tsl2561Listener_t)(const tsl2561Event_t *event, void *context);
+
+#ifndef TSL2561_MAX_LISTENERS
+#define TSL2561_MAX_LISTENERS (4) ///< Listeners per engine, no heap used
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  Non-blocking continuous acquisition for one sensor. update() is
+            called from the main loop (or a task) as often as convenient;
+            it starts and reads back conversions without ever waiting, and
+            tells the subscribed listeners about each reading.
+*/
+/**************************************************************************/
+class Adafruit_TSL2561_Engine {
+public:
+  Adafruit_TSL2561_Engine(Adafruit_TSL2561_Unified *sensor);
+
+  void setInterval(uint32_t ms);
+  void setThresholds(uint32_t low, uint32_t high);
+  bool update(void);
+
+  /* Adaptive sampling */
+  void setAdaptiveInterval(uint32_t minMs, uint32_t maxMs, uint16_t change);
+  uint32_t getInterval(void);
+  uint32_t getSampleCount(void);
+  uint32_t getSamplesSaved(void);
+
+#ifdef TSL2561_WITH_RETIMING
+  /* Duty-cycled low-power acquisition */
+  void setDutyCycle(uint16_t seconds,
+                    uint16_t budget_ms = TSL2561_DELAY_INTTIME_101MS);
+#endif
+
+  /* Last sample */
+  bool peek(tsl2561Event_t *sample, uint32_t maxAge = 0xFFFFFFFFUL);
+  uint32_t getAge(void);
+
+  /* Subscription */
+  bool subscribe(tsl2561Listener_t listener, void *context, uint8_t events);
+  bool unsubscribe(tsl2561Listener_t listener, void *context);
+
+  /*!
+      @brief  Subscribes a functor (anything callable with a
+              const tsl2561Event_t *), which must outlive the subscription
+      @param  functor Pointer to the functor
+      @param  events Mask of tsl2561EventType_t values to be told about
+      @returns False if all TSL2561_MAX_LISTENERS slots are taken
+  */
+  template <class F> bool subscribe(F *functor, uint8_t events) {
+    return subscribe(callFunctor<F>, functor, events);
+  }
+
+  /*!
+      @brief  Unsubscribes a functor
+      @param  functor Pointer given to subscribe()
+      @returns False if it wasn't subscribed
+  */
+  template <class F> bool unsubscribe(F *functor) {
+    return unsubscribe(callFunctor<F>, functor);
+  }
+
+private:
+  template <class F>
+  static void callFunctor(const tsl2561Event_t *event, void *functor) {
+    (*static_cast<F *>(functor))(event);
+  }
+
+  void dispatch(tsl2561Event_t *event, tsl2561EventType_t type);
+
+  struct {
+    tsl2561Listener_t listener;
+    void *context;
+    uint8_t events;
+  } _listeners[TSL2561_MAX_LISTENERS];
+
+  Adafruit_TSL2561_Unified *_sensor;
+  tsl2561Event_t _last; ///< Most recent sample, valid if _haveLast
+  uint32_t _interval;
+  uint32_t _minInterval;   ///< Adaptive: interval while the light changes
+  uint32_t _maxInterval;   ///< Adaptive: longest backoff, 0 when not adaptive
+  uint32_t _adaptiveSince; ///< When adaptive sampling was turned on
+  uint32_t _samples;       ///< Samples taken since then
+  uint16_t _change;        ///< Adaptive: broadband change that counts
+  uint16_t _lastBroadband;
+#ifdef TSL2561_WITH_RETIMING
+  uint16_t _planBudget; ///< Duty cycle: integration budget, 0 for none
+#endif
+  uint32_t _lastStart;
+  uint32_t _low;
+  uint32_t _high;
+  bool _converting;
+  bool _started; ///< _lastStart is valid
+  bool _haveLast;
+  int8_t _zone;  ///< Below (-1), between (0) or above (1) the thresholds
+};
+
+#ifdef TSL2561_BUS_LOCK
+/**************************************************************************/
+/*!
+    @brief  Lets several tasks share sensors and their bus. Mutex is any
+            class with lock() and unlock(), e.g. std::mutex or a wrapper
+            around a FreeRTOS mutex. The bus mutex is only held for single
+            register transactions, never across an integration, so other
+            sensors on the bus keep working while one is converting. Calls
+            on the same sensor are serialised by a mutex of its own, so
+            auto-gain can't race with setGain() or setIntegrationTime().
+*/
+/**************************************************************************/
+template <class Mutex> class Adafruit_TSL2561_Locked {
+public:
+  /*!
+      @brief  Constructor, installs the bus lock on the sensor
+      @param  sensor The sensor to guard; only use it through this wrapper
+      @param  busMutex Mutex shared by every sensor on the same bus
+  */
+  Adafruit_TSL2561_Locked(Adafruit_TSL2561_Unified *sensor, Mutex *busMutex) {
+    _sensor = sensor;
+    _busLock.mutex = busMutex;
+    _busLock.lock = lockMutex;
+    _busLock.unlock = unlockMutex;
+    sensor->setBusLock(&_busLock);
+  }
+
+  /*!
+      @brief  See Adafruit_TSL2561_Unified::begin()
+      @param  bus The bus the sensor is on
+      @returns True if the sensor was found and initialized
+  */
+  boolean begin(TwoWire *bus) {
+    Guard guard(&_mutex);
+    return _sensor->begin(bus);
+  }
+
+  /*!
+      @brief  See Adafruit_TSL2561_Unified::enableAutoRange()
+      @param  enable True to enable auto-gain
+  */
+  void enableAutoRange(bool enable) {
+    Guard guard(&_mutex);
+    _sensor->enableAutoRange(enable);
+  }
+
+  /*!
+      @brief  See Adafruit_TSL2561_Unified::setIntegrationTime()
+      @param  time The integration time to use
+  */
+  void setIntegrationTime(tsl2561IntegrationTime_t time) {
+    Guard guard(&_mutex);
+    _sensor->setIntegrationTime(time);
+  }
+
+  /*!
+      @brief  See Adafruit_TSL2561_Unified::setGain()
+      @param  gain The gain to use
+  */
+  void setGain(tsl2561Gain_t gain) {
+    Guard guard(&_mutex);
+    _sensor->setGain(gain);
+  }
+
+  /*!
+      @brief  See Adafruit_TSL2561_Unified::getLuminosity()
+      @param  broadband Filled with the broadband reading
+      @param  ir Filled with the IR reading
+  */
+  void getLuminosity(uint16_t *broadband, uint16_t *ir) {
+    Guard guard(&_mutex);
+    _sensor->getLuminosity(broadband, ir);
+  }
+
+#ifdef TSL2561_WITH_LUX
+  /*!
+      @brief  See Adafruit_TSL2561_Unified::getReading()
+      @param  reading Filled with the reading
+      @returns True if the reading is valid
+  */
+  bool getReading(tsl2561Reading_t *reading) {
+    Guard guard(&_mutex);
+    return _sensor->getReading(reading);
+  }
+#endif
+
+#ifndef TSL2561_NO_UNIFIED_SENSOR
+  /*!
+      @brief  See Adafruit_TSL2561_Unified::getEvent()
+      @param  event Filled with the event
+      @returns True if the reading is valid
+  */
+  bool getEvent(sensors_event_t *event) {
+    Guard guard(&_mutex);
+    return _sensor->getEvent(event);
+  }
+#endif
+
+private:
+  /** Holds a mutex for the rest of the scope */
+  class Guard {
+  public:
+    explicit Guard(Mutex *mutex) : _held(mutex) { _held->lock(); }
+    ~Guard() { _held->unlock(); }
+
+  private:
+    Mutex *_held;
+  };
+
+  static void lockMutex(void *mutex) { static_cast<Mutex *>(mutex)->lock(); }
+  static void unlockMutex(void *mutex) {
+    static_cast<Mutex *>(mutex)->unlock();
+  }
+
+  Adafruit_TSL2561_Unified *_sensor;
+  Mutex _mutex; ///< Serialises calls on this sensor
+  tsl2561BusLock_t _busLock;
+};
+#endif
+
+/**************************************************************************/
+/*!
+    @brief  A TSL2561 whose address, integration time, gain and package are
+            template arguments instead of TSL2561_FIXED_* build flags, so
+            they only apply to this sensor: sensors with other settings or
+            the other package, and the rest of the build, are unaffected.
+            The settings live in the type; an instance holds only its bus
+            pointer, and the clip threshold and channel scale are
+            constants. A reading is a power-up and a TIMING write (one word
+            write with TSL2561_FOLD_TIMING), the integration, two channel
+            reads and a power-down. Transactions go through the driver's and are
+            retried as set by Adafruit_TSL2561_Unified::setBusRetries().
+            There is no auto-gain, health check, bus lock, tracing, error
+            count or energy accounting; use Adafruit_TSL2561_Unified for
+            those. Package defaults to the build's, TSL2561_PACKAGE_TYPE.
+*/
+/**************************************************************************/
+template <uint8_t Addr, tsl2561IntegrationTime_t Time, tsl2561Gain_t Gain,
+          tsl2561Package_t Package = TSL2561_PACKAGE_TYPE>
+class Adafruit_TSL2561_Fixed {
+public:
+  /*!
+      @brief  Creates the sensor without touching the bus; begin() attaches
+              it and checks that it is there
+  */
+  Adafruit_TSL2561_Fixed(void) : _bus(NULL) {}
+
+  /*!
+      @brief  Checks for a TSL2561 at Addr and powers it down
+      @param  bus The bus the sensor is on
+      @returns True if the part number is TSL2561CS or TSL2561T/FN/CL
+  */
+  bool begin(TwoWire *bus) {
+    uint8_t id;
+
+    _bus = bus;
+    if (!read(TSL2561_COMMAND_BIT | TSL2561_REGISTER_ID, &id, 1) ||
+        (((id >> 4) != TSL2561_ID_PARTNO_CS) &&
+         ((id >> 4) != TSL2561_ID_PARTNO_T_FN_CL))) {
+      _bus = NULL;
+      return false;
+    }
+    return write(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL,
+                 TSL2561_CONTROL_POWEROFF, 1);
+  }
+
+  /*!
+      @brief  Takes one reading, blocking for the integration
+      @param  broadband Filled with the broadband reading, 0 on a bus error
+      @param  ir Filled with the IR reading, 0 on a bus error
+      @returns True if the bus didn't fail
+  */
+  bool getLuminosity(uint16_t *broadband, uint16_t *ir) {
+    uint8_t data[4];
+
+#ifdef TSL2561_FOLD_TIMING
+    /* A word write fills CONTROL and then TIMING, see
+       Adafruit_TSL2561_Unified::enable() */
+    bool ok = write(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT |
+                        TSL2561_REGISTER_CONTROL,
+                    ((uint16_t)((uint8_t)Time | Gain) << 8) |
+                        TSL2561_CONTROL_POWERON,
+                    2);
+#else
+    bool ok = write(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL,
+                    TSL2561_CONTROL_POWERON, 1) &&
+              write(TSL2561_COMMAND_BIT | TSL2561_REGISTER_TIMING,
+                    (uint8_t)Time | Gain, 1);
+#endif
+    if (ok) {
+      Adafruit_TSL2561_Unified::clockDelay(delayMs());
+      ok = read(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT |
+                    TSL2561_REGISTER_CHAN0_LOW,
+                data, 2) &&
+           read(TSL2561_COMMAND_BIT | TSL2561_WORD_BIT |
+                    TSL2561_REGISTER_CHAN1_LOW,
+                data + 2, 2);
+    }
+    write(TSL2561_COMMAND_BIT | TSL2561_REGISTER_CONTROL,
+          TSL2561_CONTROL_POWEROFF, 1);
+
+    *broadband = ok ? (data[0] | (data[1] << 8)) : 0;
+    *ir = ok ? (data[2] | (data[3] << 8)) : 0;
+    return ok;
+  }
+
+#ifdef TSL2561_WITH_LUX
+  /*!
+      @brief  Takes one reading and converts it to lux
+      @param  lux Filled with the lux value, 65536 if the sensor saturated
+      @returns True if the reading is valid, false if the sensor is
+               saturated or the bus failed
+  */
+  bool getLux(uint32_t *lux) {
+    uint16_t broadband, ir;
+
+    *lux = 0;
+    if (!getLuminosity(&broadband, &ir))
+      return false;
+    *lux = calculateLux(broadband, ir);
+    return (*lux != 65536);
+  }
+
+  /*!
+      @brief  Same as Adafruit_TSL2561_Unified::calculateLux() with this
+              sensor's integration time and gain
+      @param  broadband The 16-bit reading from the IR+visible light diode
+      @param  ir The 16-bit reading from the IR-only light diode
+      @returns The lux value, or 65536 if the sensor is saturated
+  */
+  static uint32_t calculateLux(uint16_t broadband, uint16_t ir) {
+    if ((broadband > clip()) || (ir > clip()))
+      return 65536;
+
+    uint32_t temp = Adafruit_TSL2561_Unified::luxFromChannels<Package>(
+        ((uint32_t)broadband * channelScale()) >> TSL2561_LUX_CHSCALE,
+        ((uint32_t)ir * channelScale()) >> TSL2561_LUX_CHSCALE);
+    return (temp + (1 << (TSL2561_LUX_LUXSCALE - 1))) >> TSL2561_LUX_LUXSCALE;
+  }
+#endif
+
+private:
+  /* Constants of the type; they fold away at any optimisation level */
+  static uint16_t delayMs(void) {
+    if (Time == TSL2561_INTEGRATIONTIME_13MS)
+      return TSL2561_DELAY_INTTIME_13MS;
+    if (Time == TSL2561_INTEGRATIONTIME_101MS)
+      return TSL2561_DELAY_INTTIME_101MS;
+    return TSL2561_DELAY_INTTIME_402MS;
+  }
+  static uint16_t clip(void) {
+    if (Time == TSL2561_INTEGRATIONTIME_13MS)
+      return TSL2561_CLIPPING_13MS;
+    if (Time == TSL2561_INTEGRATIONTIME_101MS)
+      return TSL2561_CLIPPING_101MS;
+    return TSL2561_CLIPPING_402MS;
+  }
+  static uint32_t channelScale(void) {
+    uint32_t scale = 1UL << TSL2561_LUX_CHSCALE;
+    if (Time == TSL2561_INTEGRATIONTIME_13MS)
+      scale = TSL2561_LUX_CHSCALE_TINT0;
+    else if (Time == TSL2561_INTEGRATIONTIME_101MS)
+      scale = TSL2561_LUX_CHSCALE_TINT1;
+    return (Gain == TSL2561_GAIN_1X) ? (scale << 4) : scale;
+  }
+
+  /* The driver's transactions and retry policy, without its per-sensor
+     bookkeeping */
+  bool write(uint8_t reg, uint16_t value, uint8_t len) {
+    for (uint8_t attempt = 0; _bus; attempt++) {
+      if (Adafruit_TSL2561_Unified::busWrite(_bus, Addr, reg, value, len))
+        return true;
+      if (!Adafruit_TSL2561_Unified::retryWait(attempt, NULL))
+        break;
+    }
+    return false;
+  }
+
+  bool read(uint8_t reg, uint8_t *buffer, uint8_t len) {
+    for (uint8_t attempt = 0; _bus; attempt++) {
+      if (Adafruit_TSL2561_Unified::busRead(_bus, Addr, reg, buffer, len))
+        return true;
+      if (!Adafruit_TSL2561_Unified::retryWait(attempt, NULL))
+        break;
+    }
+    return false;
+  }
 
-  void enable(void);
-  void disable(void);
-  void write8(uint8_t reg, uint8_t value);
-  uint8_t read8(uint8_t reg);
-  uint16_t read16(uint8_t reg);
-  void getData(uint16_t *broadband, uint16_t *ir);
+  TwoWire *_bus;
 };
 
 #endif // ADAFRUIT_TSL2561_H
@@ -0,0 +1,119 @@
+#include <Wire.h>
+#include <Adafruit_Sensor.h>
+#include <Adafruit_TSL2561_U.h>
+
+/* Reads several sensors from C++20 coroutines on a single thread. Each
+   sensor has its own coroutine, which is suspended during the integration
+   instead of blocking in delay(), so all of the conversions overlap.
+
+   Needs a toolchain with C++20 coroutines (e.g. a recent ESP32 core built
+   with -std=gnu++2a); on anything else this sketch only prints a notice.
+
+   The scheduler below is deliberately small: a fixed list of coroutines
+   waiting for a time, polled from loop(). A timer interrupt could just as
+   well resume them. */
+
+#ifdef TSL2561_WITH_COROUTINES
+
+/* Coroutine type that starts straight away and is never awaited itself */
+struct SensorTask {
+  struct promise_type {
+    SensorTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+};
+
+/* Resumes each waiting coroutine once its conversion is due */
+class TimerScheduler : public Adafruit_TSL2561_Scheduler {
+public:
+  static const uint8_t SLOTS = 8;
+
+  bool resumeAt(std::coroutine_handle<> handle, uint32_t when) override {
+    for (uint8_t i = 0; i < SLOTS; i++) {
+      if (!_waiting[i]) {
+        _waiting[i] = handle;
+        _when[i] = when;
+        return true;
+      }
+    }
+    /* No room: the coroutine carries on, readConversion() will wait */
+    return false;
+  }
+
+  void poll() {
+    uint32_t now = Adafruit_TSL2561_Unified::clockMillis();
+    for (uint8_t i = 0; i < SLOTS; i++) {
+      if (_waiting[i] && ((int32_t)(now - _when[i]) >= 0)) {
+        std::coroutine_handle<> handle = _waiting[i];
+        _waiting[i] = nullptr;
+        handle.resume();
+      }
+    }
+  }
+
+private:
+  std::coroutine_handle<> _waiting[SLOTS];
+  uint32_t _when[SLOTS];
+};
+
+TimerScheduler scheduler;
+
+/* co_await Sleep{ms} suspends a coroutine for a while */
+struct Sleep {
+  uint32_t ms;
+  bool await_ready() { return false; }
+  bool await_suspend(std::coroutine_handle<> handle) {
+    return scheduler.resumeAt(handle,
+                              Adafruit_TSL2561_Unified::clockMillis() + ms);
+  }
+  void await_resume() {}
+};
+
+Adafruit_TSL2561_Unified sensors[3] = {
+    Adafruit_TSL2561_Unified(TSL2561_ADDR_LOW, 1),
+    Adafruit_TSL2561_Unified(TSL2561_ADDR_FLOAT, 2),
+    Adafruit_TSL2561_Unified(TSL2561_ADDR_HIGH, 3)};
+
+SensorTask readForever(Adafruit_TSL2561_Unified *tsl, uint8_t index) {
+  for (;;) {
+    uint16_t broadband, ir;
+    if (co_await tsl->readAsync(&scheduler, &broadband, &ir)) {
+      Serial.print("Sensor ");
+      Serial.print(index);
+      Serial.print(": ");
+      Serial.print(tsl->calculateLux(broadband, ir));
+      Serial.println(" lux");
+    } else {
+      /* Try again later rather than spinning on a dead sensor */
+      co_await Sleep{1000};
+    }
+  }
+}
+
+void setup(void) {
+  Serial.begin(9600);
+  Serial.println("TSL2561 coroutine example");
+
+  for (uint8_t i = 0; i < 3; i++) {
+    if (sensors[i].begin()) {
+      sensors[i].setIntegrationTime(TSL2561_INTEGRATIONTIME_101MS);
+      readForever(&sensors[i], i);
+    }
+  }
+}
+
+void loop(void) { scheduler.poll(); }
+
+#else
+
+void setup(void) {
+  Serial.begin(9600);
+  Serial.println("This example needs a compiler with C++20 coroutines");
+}
+
+void loop(void) {}
+
+#endif
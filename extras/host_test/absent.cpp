@@ -0,0 +1,72 @@
+/*!
+ * @file absent.cpp
+ *
+ * A sensor on Wire whose begin() failed, because nothing answers at its
+ * address, with retries and backoff configured. Every call that initialises
+ * the sensor on demand must try begin() once, report a bus fault and give up
+ * straight away: begin()'s retried ID read is all it may cost, with no
+ * power-up, no conversion and no second begin().
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <stdio.h>
+
+static int failed = 0;
+
+/* What the failed begin() cost, which each call may spend once */
+static uint32_t beginUs, beginNacks;
+
+/* Runs one call and checks what it cost: one begin(), nothing else */
+#define EXPECT_FAST(name, call)                                                \
+  do {                                                                         \
+    Wire.resetCounters();                                                      \
+    uint32_t start = micros();                                                 \
+    call;                                                                      \
+    uint32_t took = micros() - start;                                          \
+    if ((took > beginUs) || (Wire.begins != 1) ||                              \
+        (Wire.nacks != beginNacks) || !tsl.getBusFault()) {                    \
+      printf("FAILED: %s took %uus, %u begin(), %u NACKs, fault %d\n", name,   \
+             took, Wire.begins.load(), Wire.nacks.load(), tsl.getBusFault());  \
+      failed = 1;                                                              \
+    } else {                                                                   \
+      printf("%-20s %6uus, one begin(), %u NACKed ID reads\n", name, took,     \
+             beginNacks);                                                      \
+    }                                                                          \
+  } while (0)
+
+int main(void) {
+  HostTSL2561 elsewhere(TSL2561_ADDR_LOW);
+  Wire.attach(&elsewhere);
+  Adafruit_TSL2561_Unified::setBusRetries(3, 20);
+
+  Adafruit_TSL2561_Unified tsl(TSL2561_ADDR_FLOAT);
+  Wire.resetCounters();
+  uint32_t start = micros();
+  if (tsl.begin()) {
+    printf("FAILED: begin() found a sensor\n");
+    failed = 1;
+  }
+  beginUs = micros() - start;
+  beginNacks = Wire.nacks;
+  printf("%-20s %6uus, %u NACKed ID reads\n", "begin()", beginUs, beginNacks);
+
+  uint16_t broadband = 1, ir = 1;
+  EXPECT_FAST("getLuminosity()", tsl.getLuminosity(&broadband, &ir));
+  if (broadband || ir) {
+    printf("FAILED: getLuminosity() read %u/%u\n", broadband, ir);
+    failed = 1;
+  }
+  EXPECT_FAST("startConversion()", tsl.startConversion());
+  EXPECT_FAST("setGain()", tsl.setGain(TSL2561_GAIN_16X));
+  EXPECT_FAST("setIntegrationTime()",
+              tsl.setIntegrationTime(TSL2561_INTEGRATIONTIME_13MS));
+  sensors_event_t event;
+  EXPECT_FAST("getEvent()", tsl.getEvent(&event));
+  uint32_t lux, precision;
+  EXPECT_FAST("getLuxWithin()", tsl.getLuxWithin(500, &lux, &precision));
+  EXPECT_FAST("getLuxHDR()", tsl.getLuxHDR(&lux));
+
+  Adafruit_TSL2561_Unified::setBusRetries(0, 0);
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,196 @@
+/*!
+ * @file bench_coroutines.cpp
+ *
+ * readAsync() coroutines against a thread per sensor, on real time (C++20):
+ * 300 simulated sensors at 101ms integrations, each on a bus of its own so
+ * the threads need no lock. The buses take no time, or the one coroutine
+ * thread would be timing 300 transfers one after another while the
+ * threads overlap them: what is compared is the cost of waiting out the
+ * integrations. First every sensor is read from a coroutine on the main
+ * thread, with a scheduler that sleeps until the next conversion is due,
+ * then from its own std::thread calling startConversion() and
+ * readConversion(). Reports samples per second, the CPU time used and the
+ * growth in resident memory for both, against the ceiling the driver's
+ * 120ms wait for a 101ms integration sets. Every sample must be non-zero,
+ * and the coroutines must keep up with the threads.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <atomic>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+#define BENCH_SENSORS (300) ///< Sensors, one per bus
+#define BENCH_MS (2000)     ///< Run time of each method
+#define BENCH_SHARE (90)    ///< Share of the threads' rate, in percent
+
+/** Coroutine type that starts straight away and is never awaited itself */
+struct SensorTask {
+  struct promise_type {
+    SensorTask get_return_object() { return {}; }
+    std::suspend_never initial_suspend() { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() {}
+  };
+};
+
+/** Resumes waiting coroutines once their conversions are due */
+class SleepScheduler : public Adafruit_TSL2561_Scheduler {
+public:
+  bool resumeAt(std::coroutine_handle<> handle, uint32_t when) override {
+    _waiting.push_back(Waiter{handle, when});
+    return true;
+  }
+
+  /* Sleeps until the first coroutine is due, then resumes every due one */
+  void poll(void) {
+    if (_waiting.empty())
+      return;
+    uint32_t now = millis();
+    int32_t wait = (int32_t)(_waiting[0].when - now);
+    for (const Waiter &waiter : _waiting) {
+      if ((int32_t)(waiter.when - now) < wait)
+        wait = (int32_t)(waiter.when - now);
+    }
+    if (wait > 0)
+      delay(wait);
+
+    now = millis();
+    std::vector<Waiter> due, later;
+    for (const Waiter &waiter : _waiting)
+      ((int32_t)(now - waiter.when) >= 0 ? due : later).push_back(waiter);
+    _waiting.swap(later);
+    for (const Waiter &waiter : due)
+      waiter.handle.resume();
+  }
+
+private:
+  struct Waiter {
+    std::coroutine_handle<> handle;
+    uint32_t when;
+  };
+  std::vector<Waiter> _waiting;
+};
+
+static std::atomic<bool> stop(false);
+static std::atomic<uint32_t> samples(0), zeros(0);
+
+static SensorTask readForever(Adafruit_TSL2561_Unified *sensor,
+                              SleepScheduler *scheduler) {
+  while (!stop) {
+    uint16_t broadband, ir;
+    if (co_await sensor->readAsync(scheduler, &broadband, &ir) && broadband)
+      samples++;
+    else
+      zeros++;
+  }
+}
+
+/* CPU seconds and peak resident kB so far */
+static void usage(double *cpu, long *rssKb) {
+  struct rusage now;
+  getrusage(RUSAGE_SELF, &now);
+  *cpu = now.ru_utime.tv_sec + now.ru_utime.tv_usec / 1e6 +
+         now.ru_stime.tv_sec + now.ru_stime.tv_usec / 1e6;
+  *rssKb = now.ru_maxrss;
+}
+
+int main(void) {
+  std::vector<TwoWire> buses(BENCH_SENSORS);
+  std::vector<HostTSL2561 *> chips(BENCH_SENSORS);
+  std::vector<Adafruit_TSL2561_Unified *> sensors(BENCH_SENSORS);
+  int failed = 0;
+
+  for (uint16_t i = 0; i < BENCH_SENSORS; i++) {
+    chips[i] = new HostTSL2561();
+    chips[i]->light = 5 + i % 50;
+    buses[i].byteTimeUs = 0;
+    buses[i].attach(chips[i]);
+    sensors[i] = new Adafruit_TSL2561_Unified(TSL2561_ADDR_FLOAT, i);
+    if (!sensors[i]->begin(&buses[i])) {
+      printf("FAILED: sensor %u not found\n", i);
+      return 1;
+    }
+    sensors[i]->setIntegrationTime(TSL2561_INTEGRATIONTIME_101MS);
+  }
+  hostSetRealTime(true);
+
+  /* Coroutines, all on this thread */
+  SleepScheduler scheduler;
+  double cpuBefore, cpuAfter;
+  long rssBefore, rssAfter;
+  usage(&cpuBefore, &rssBefore);
+  uint32_t start = millis();
+  for (Adafruit_TSL2561_Unified *sensor : sensors)
+    readForever(sensor, &scheduler);
+  while (millis() - start < BENCH_MS)
+    scheduler.poll();
+  uint32_t coroutineSamples = samples, elapsed = millis() - start;
+  stop = true;
+  /* Let every coroutine see stop and finish */
+  while (millis() - start < BENCH_MS + 200)
+    scheduler.poll();
+  usage(&cpuAfter, &rssAfter);
+  double coroutineRate = coroutineSamples * 1000.0 / elapsed;
+  double coroutineCpu = cpuAfter - cpuBefore;
+  long coroutineKb = rssAfter - rssBefore;
+
+  /* A thread per sensor */
+  stop = false;
+  samples = 0;
+  std::vector<std::thread> threads;
+  usage(&cpuBefore, &rssBefore);
+  start = millis();
+  for (Adafruit_TSL2561_Unified *sensor : sensors) {
+    threads.emplace_back([sensor] {
+      while (!stop) {
+        uint16_t broadband, ir;
+        if (sensor->startConversion() &&
+            sensor->readConversion(&broadband, &ir) && broadband)
+          samples++;
+        else
+          zeros++;
+      }
+    });
+  }
+  while (millis() - start < BENCH_MS)
+    delay(10);
+  uint32_t threadSamples = samples;
+  elapsed = millis() - start;
+  stop = true;
+  for (std::thread &thread : threads)
+    thread.join();
+  usage(&cpuAfter, &rssAfter);
+  double threadRate = threadSamples * 1000.0 / elapsed;
+  double threadCpu = cpuAfter - cpuBefore;
+  long threadKb = rssAfter - rssBefore;
+  hostSetRealTime(false);
+
+  printf("%u sensors, 101ms, %u hardware threads, ceiling %.0f samples/s\n",
+         BENCH_SENSORS, std::thread::hardware_concurrency(),
+         BENCH_SENSORS * 1000.0 / TSL2561_DELAY_INTTIME_101MS);
+  printf("%-30s %8.0f samples/s %6.2fs CPU %+8ld kB\n",
+         "coroutines, 1 thread:", coroutineRate, coroutineCpu, coroutineKb);
+  printf("%-30s %8.0f samples/s %6.2fs CPU %+8ld kB\n",
+         "thread per sensor:", threadRate, threadCpu, threadKb);
+
+  if (zeros) {
+    printf("FAILED: %u failed or empty samples\n", zeros.load());
+    failed = 1;
+  }
+  if (coroutineRate < threadRate * BENCH_SHARE / 100) {
+    printf("FAILED: coroutines are below %u%% of the threads' rate\n",
+           BENCH_SHARE);
+    failed = 1;
+  }
+
+  for (uint16_t i = 0; i < BENCH_SENSORS; i++) {
+    delete sensors[i];
+    delete chips[i];
+  }
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,125 @@
+/*!
+ * @file bench_mux.cpp
+ *
+ * 24 sensors behind a TCA9548A, 3 per channel on all 8 channels, at 101ms
+ * integrations on a 100kHz bus (simulated time). Reads the whole array
+ * one sensor at a time with getLuminosity(), writing the mux before each
+ * sensor as a plain sketch would, then with Adafruit_TSL2561_Mux::scan(),
+ * and reports samples per second and mux writes per pass for both. Every
+ * sensor sees its own light level, so scan() must read back exactly what
+ * the one-by-one pass did. A channel that can't be selected must not
+ * leave its sensors converting.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <stdio.h>
+
+#define BENCH_PER_CHANNEL (3) ///< One sensor at each TSL2561 address
+#define BENCH_SENSORS (TSL2561_MUX_CHANNELS * BENCH_PER_CHANNEL)
+#define BENCH_PASSES (20) ///< Passes over the whole array per method
+
+static const uint8_t addresses[BENCH_PER_CHANNEL] = {
+    TSL2561_ADDR_LOW, TSL2561_ADDR_FLOAT, TSL2561_ADDR_HIGH};
+
+int main(void) {
+  TwoWire bus;
+  HostTCA9548A muxChip(TSL2561_MUX_ADDR);
+  bus.attach(&muxChip);
+
+  static HostTSL2561 *chips[BENCH_SENSORS];
+  static Adafruit_TSL2561_Unified *sensors[BENCH_SENSORS];
+  tsl2561MuxSlot_t slots[BENCH_SENSORS];
+  Adafruit_TSL2561_Mux mux(&bus);
+  int failed = 0;
+
+  for (uint8_t i = 0; i < BENCH_SENSORS; i++) {
+    uint8_t channel = i / BENCH_PER_CHANNEL;
+    chips[i] = new HostTSL2561(addresses[i % BENCH_PER_CHANNEL]);
+    chips[i]->light = 1 + 3 * i;
+    muxChip.attach(channel, chips[i]);
+
+    sensors[i] = new Adafruit_TSL2561_Unified(addresses[i % BENCH_PER_CHANNEL]);
+    mux.select(channel);
+    if (!sensors[i]->begin(&bus)) {
+      printf("FAILED: sensor %u not found\n", i);
+      return 1;
+    }
+    sensors[i]->setIntegrationTime(TSL2561_INTEGRATIONTIME_101MS);
+    slots[i].sensor = sensors[i];
+    slots[i].channel = channel;
+  }
+
+  /* One sensor at a time, selecting its channel every time */
+  uint16_t expected[BENCH_SENSORS];
+  hostResetClock();
+  muxChip.selects = 0;
+  for (uint8_t pass = 0; pass < BENCH_PASSES; pass++) {
+    for (uint8_t i = 0; i < BENCH_SENSORS; i++) {
+      uint16_t ir;
+      mux.invalidate();
+      mux.select(slots[i].channel);
+      sensors[i]->getLuminosity(&expected[i], &ir);
+    }
+  }
+  double serialSeconds = micros() / 1e6;
+  double serialSelects = (double)muxChip.selects / BENCH_PASSES;
+
+  /* scan(): overlapping integrations, one select per channel change */
+  hostResetClock();
+  muxChip.selects = 0;
+  for (uint8_t pass = 0; pass < BENCH_PASSES; pass++) {
+    if (mux.scan(slots, BENCH_SENSORS) != BENCH_SENSORS) {
+      printf("FAILED: scan() missed sensors\n");
+      failed = 1;
+    }
+  }
+  double scanSeconds = micros() / 1e6;
+  double scanSelects = (double)muxChip.selects / BENCH_PASSES;
+
+  for (uint8_t i = 0; i < BENCH_SENSORS; i++) {
+    if (!slots[i].valid || (slots[i].broadband != expected[i])) {
+      printf("FAILED: sensor %u read %u by scan(), %u one by one\n", i,
+             slots[i].broadband, expected[i]);
+      failed = 1;
+    }
+  }
+
+  /* A channel the mux stops switching to after the conversions started:
+     its sensors must be dropped, not read back as fresh next time */
+  mux.startAll(slots, BENCH_SENSORS);
+  muxChip.nackChannels = 1 << 3;
+  if (mux.readAll(slots, BENCH_SENSORS) != BENCH_SENSORS - BENCH_PER_CHANNEL) {
+    printf("FAILED: readAll() with channel 3 unreachable\n");
+    failed = 1;
+  }
+  muxChip.nackChannels = 0;
+  mux.select(3);
+  for (uint8_t i = 3 * BENCH_PER_CHANNEL; i < 4 * BENCH_PER_CHANNEL; i++) {
+    uint16_t broadband, ir;
+    if (slots[i].valid || sensors[i]->readConversion(&broadband, &ir)) {
+      printf("FAILED: sensor %u kept converting behind a failed select\n",
+             i);
+      failed = 1;
+    }
+  }
+
+  double serialRate = BENCH_SENSORS * BENCH_PASSES / serialSeconds;
+  double scanRate = BENCH_SENSORS * BENCH_PASSES / scanSeconds;
+  printf("%u channels x %u sensors, 101ms, 100kHz\n", TSL2561_MUX_CHANNELS,
+         BENCH_PER_CHANNEL);
+  printf("%-28s %8.1f samples/s %6.1f mux writes/pass\n",
+         "one by one, select each:", serialRate, serialSelects);
+  printf("%-28s %8.1f samples/s %6.1f mux writes/pass\n",
+         "Adafruit_TSL2561_Mux::scan:", scanRate, scanSelects);
+  if (scanRate <= serialRate) {
+    printf("FAILED: scan() is no faster\n");
+    failed = 1;
+  }
+
+  for (uint8_t i = 0; i < BENCH_SENSORS; i++) {
+    delete sensors[i];
+    delete chips[i];
+  }
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,240 @@
+/*!
+ * @file bench_week.cpp
+ *
+ * One simulated week of day/night light with passing clouds, read once a
+ * minute, with the energy accounting of TSL2561_ENERGY (simulated time).
+ * Compares getEvent() with auto-gain at 402ms and at 13ms against
+ * Adafruit_TSL2561_Engine::setDutyCycle() with a 402ms and a 101ms
+ * budget, and reports the time powered up, power transitions, bus
+ * transactions and bytes, and the estimated charge of each. Every method
+ * wakes on the same minute boundaries, so all of them take the same number
+ * of readings. A duty-cycled wake must be exactly two power transitions
+ * and six transactions, plus a TIMING write when the plan changes unless
+ * built with TSL2561_FOLD_TIMING, no method may read 0 lux in daylight, and the duty
+ * cycle must draw no more than getEvent() at the same budget. At the
+ * default 101ms budget it must save at least a fifth of getEvent()'s
+ * charge at 402ms. How many wakes used 402ms at 16x is reported too: with
+ * a 402ms budget that is most of them, so the saving is small. A last
+ * run checks the sensor before every wake and browns it out once: the
+ * reset must be repaired, once.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <math.h>
+#include <stdio.h>
+
+#define WEEK_MS (7UL * 24 * 3600 * 1000) ///< Length of each run
+#define HOUR_MS (3600UL * 1000)          ///< One hour
+#define WEEK_EVERY_S (60)                ///< Seconds between readings
+#define WEEK_DAYLIGHT (1.0) ///< Light above which 0 lux is a bad reading
+#define WEEK_DEFAULT_SAVING (20) ///< % the default duty cycle must save
+
+/* Broadband counts per ms at 1x: 0.002 at night, 40 at noon, and a
+   quarter of that under the cloud that passes for 5 minutes in every 37 */
+static double lightAt(uint32_t ms) {
+  double sun = sin((fmod(ms / (double)HOUR_MS, 24) - 6) / 12 * M_PI);
+  double light = 0.002;
+  if (sun > 0) {
+    light += 40 * sun * sun;
+    if ((ms / 60000) % 37 < 5)
+      light *= 0.25;
+  }
+  return light;
+}
+
+/* Transactions a duty-cycled wake may take: power-up, two channel reads
+   and power-down, and a TIMING write of its own on a plan change unless it
+   is folded into the power-up */
+#ifdef TSL2561_FOLD_TIMING
+#define WEEK_WAKE_MAX 6
+#else
+#define WEEK_WAKE_MAX 7
+#endif
+
+/* TIMING register value of the longest plan, 402ms at 16x */
+#define WEEK_LONGEST (0x12)
+
+/* What one run measured */
+struct Run {
+  const char *name;
+  uint32_t samples;
+  uint32_t bad;     ///< Readings of 0 lux in daylight
+  uint32_t longest; ///< Readings taken at 402ms and 16x
+  uint32_t transactions;
+  tsl2561Energy_t energy;
+};
+
+/* Counts the engine's samples, the bad ones and the longest ones */
+struct Tally {
+  HostTSL2561 *chip;
+  uint32_t samples;
+  uint32_t bad;
+  uint32_t longest;
+};
+
+static void countSample(const tsl2561Event_t *event, void *context) {
+  Tally *tally = (Tally *)context;
+  tally->samples++;
+  if (!event->level && (tally->chip->light > WEEK_DAYLIGHT))
+    tally->bad++;
+  if ((tally->chip->regs[0x01] & 0x13) == WEEK_LONGEST)
+    tally->longest++;
+}
+
+static void show(const Run &run) {
+  printf("%-26s %6u %6u %8.0fs %7u %7u %7u %7.0f\n", run.name, run.samples,
+         run.longest, run.energy.onTime_ms / 1000.0,
+         run.energy.powerTransitions, run.transactions, run.energy.busBytes,
+         run.energy.charge_uAh);
+}
+
+/* getEvent() with auto-gain, once every WEEK_EVERY_S */
+static Run polled(const char *name, tsl2561IntegrationTime_t time) {
+  HostTSL2561 chip;
+  TwoWire bus;
+  bus.attach(&chip);
+  hostResetClock();
+
+  Adafruit_TSL2561_Unified tsl(TSL2561_ADDR_FLOAT);
+  tsl.begin(&bus);
+  tsl.enableAutoRange(true);
+  tsl.setIntegrationTime(time);
+  tsl.resetEnergy();
+  bus.resetCounters();
+
+  Run run = {name, 0, 0, 0, 0, {}};
+  uint32_t start = millis();
+  for (uint32_t k = 1; millis() - start < WEEK_MS; k++) {
+    chip.light = lightAt(millis() - start);
+    sensors_event_t event;
+    tsl.getEvent(&event);
+    run.samples++;
+    if (!event.light && (chip.light > WEEK_DAYLIGHT))
+      run.bad++;
+    if ((chip.regs[0x01] & 0x13) == WEEK_LONGEST)
+      run.longest++;
+    uint32_t next = k * WEEK_EVERY_S * 1000UL;
+    if (millis() - start < next)
+      delay(next - (millis() - start));
+  }
+  tsl.getEnergy(&run.energy);
+  run.transactions = bus.transactions;
+  return run;
+}
+
+/* The engine's duty cycle; with health set, the sensor is checked before
+   every wake and browns out on the third day */
+static Run dutyCycled(const char *name, uint16_t budget, bool health,
+                      uint8_t *recoveries) {
+  HostTSL2561 chip;
+  TwoWire bus;
+  bus.attach(&chip);
+  hostResetClock();
+
+  Adafruit_TSL2561_Unified tsl(TSL2561_ADDR_FLOAT);
+  tsl.begin(&bus);
+  if (health)
+    tsl.setHealthCheckInterval(1);
+  Adafruit_TSL2561_Engine engine(&tsl);
+  engine.setDutyCycle(WEEK_EVERY_S, budget);
+  Tally tally = {&chip, 0, 0, 0};
+  engine.subscribe(countSample, &tally, TSL2561_EVENT_SAMPLE);
+  tsl.resetEnergy();
+  bus.resetCounters();
+
+  /* Wake the engine on the same minute boundaries as polled(), and again
+     once the conversion is done */
+  bool lost = false;
+  uint32_t start = millis();
+  for (uint32_t k = 1; millis() - start < WEEK_MS; k++) {
+    uint32_t now = millis() - start;
+    chip.light = lightAt(now);
+    if (health && !lost && (now >= 50 * HOUR_MS)) {
+      chip.powerLoss();
+      lost = true;
+    }
+    engine.update();
+    delay(tsl.getConversionTimeLeft());
+    engine.update();
+    uint32_t next = k * WEEK_EVERY_S * 1000UL;
+    if (millis() - start < next)
+      delay(next - (millis() - start));
+  }
+
+  Run run = {name, tally.samples, tally.bad, tally.longest, bus.transactions,
+             {}};
+  tsl.getEnergy(&run.energy);
+  if (recoveries)
+    *recoveries = tsl.getRecoveryCount();
+  return run;
+}
+
+int main(void) {
+  int failed = 0;
+
+  Run runs[4] = {
+      polled("getEvent() AGC 402ms", TSL2561_INTEGRATIONTIME_402MS),
+      polled("getEvent() AGC 13ms", TSL2561_INTEGRATIONTIME_13MS),
+      dutyCycled("setDutyCycle(60, 402ms)", TSL2561_DELAY_INTTIME_402MS,
+                 false, NULL),
+      dutyCycled("setDutyCycle(60)", TSL2561_DELAY_INTTIME_101MS, false,
+                 NULL)};
+  uint8_t recoveries;
+  Run checked = dutyCycled("checked, one brown-out",
+                           TSL2561_DELAY_INTTIME_101MS, true, &recoveries);
+
+  printf("one week, a reading every %us\n", WEEK_EVERY_S);
+  printf("%-26s %6s %6s %9s %7s %7s %7s %7s\n", "", "reads", "402/16",
+         "on", "up/down", "starts", "bytes", "uAh");
+  for (const Run &run : runs)
+    show(run);
+  show(checked);
+  printf("recoveries in the checked run: %u\n", recoveries);
+  float saving =
+      100 * (1 - runs[3].energy.charge_uAh / runs[0].energy.charge_uAh);
+  printf("the default 101ms budget saves %.0f%% over getEvent() at 402ms; a "
+         "402ms budget saves %.0f%%, %u of %u wakes using 402ms at 16x\n",
+         saving,
+         100 * (1 - runs[2].energy.charge_uAh / runs[0].energy.charge_uAh),
+         runs[2].longest, runs[2].samples);
+
+  for (const Run &run : runs) {
+    if (run.samples != runs[0].samples) {
+      printf("FAILED: %s took %u readings, getEvent() %u\n", run.name,
+             run.samples, runs[0].samples);
+      failed = 1;
+    }
+    if (run.bad) {
+      printf("FAILED: %s read 0 lux in daylight %u times\n", run.name,
+             run.bad);
+      failed = 1;
+    }
+  }
+  for (uint8_t i = 2; i < 4; i++) {
+    if ((runs[i].energy.powerTransitions != 2 * runs[i].samples) ||
+        (runs[i].transactions < 6 * runs[i].samples) ||
+        (runs[i].transactions > WEEK_WAKE_MAX * runs[i].samples)) {
+      printf("FAILED: %s: %u wakes, %u transitions, %u transactions\n",
+             runs[i].name, runs[i].samples, runs[i].energy.powerTransitions,
+             runs[i].transactions);
+      failed = 1;
+    }
+  }
+  if (runs[2].energy.charge_uAh > runs[0].energy.charge_uAh) {
+    printf("FAILED: the duty cycle drew more than getEvent() at 402ms\n");
+    failed = 1;
+  }
+  if (saving < WEEK_DEFAULT_SAVING) {
+    printf("FAILED: the default duty cycle saves under %u%%\n",
+           WEEK_DEFAULT_SAVING);
+    failed = 1;
+  }
+  if ((recoveries != 1) || checked.bad) {
+    printf("FAILED: checked run: %u recoveries, %u bad readings\n",
+           recoveries, checked.bad);
+    failed = 1;
+  }
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,177 @@
+/*!
+ * @file bench_workers.cpp
+ *
+ * Adafruit_TSL2561_BusWorker scaling with std::thread, on real time:
+ * 1, 2 and 4 simulated buses of 3 sensors each at 13ms integrations and
+ * 100kHz byte timing. Each configuration runs first with one thread
+ * cycling through the workers, then with a thread per worker while the
+ * main thread reads the shared samples as fast as it can. Then one
+ * publisher and several readers hammer a single shared sample whose
+ * fields are always published consistent with each other, and any torn
+ * copy readShared() returns fails the run. Build it with
+ * -fsanitize=thread (make tsan) to check the seqlock for data races.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#define BENCH_PER_BUS (3)      ///< One sensor at each TSL2561 address
+#define BENCH_MS (1000)        ///< Run time of each measurement
+#define BENCH_READERS (3)      ///< Reader threads in the torture test
+#define BENCH_TORTURE_MS (500) ///< Run time of the torture test
+
+static const uint8_t addresses[BENCH_PER_BUS] = {
+    TSL2561_ADDR_LOW, TSL2561_ADDR_FLOAT, TSL2561_ADDR_HIGH};
+
+/** Simulated buses with their sensors and a worker each */
+struct Rig {
+  explicit Rig(uint8_t buses)
+      : wires(buses), chips(buses * BENCH_PER_BUS),
+        sensors(buses * BENCH_PER_BUS), samples(buses * BENCH_PER_BUS) {
+    for (uint8_t b = 0; b < buses; b++) {
+      for (uint8_t i = 0; i < BENCH_PER_BUS; i++) {
+        uint8_t n = b * BENCH_PER_BUS + i;
+        chips[n] = new HostTSL2561(addresses[i]);
+        chips[n]->light = 10 * (n + 1);
+        wires[b].attach(chips[n]);
+        sensors[n] = new Adafruit_TSL2561_Unified(addresses[i]);
+        sensors[n]->begin(&wires[b]);
+        sensors[n]->setIntegrationTime(TSL2561_INTEGRATIONTIME_13MS);
+      }
+      workers.push_back(new Adafruit_TSL2561_BusWorker(
+          &sensors[b * BENCH_PER_BUS], &samples[b * BENCH_PER_BUS],
+          BENCH_PER_BUS));
+    }
+  }
+  ~Rig() {
+    for (Adafruit_TSL2561_BusWorker *worker : workers)
+      delete worker;
+    for (size_t n = 0; n < chips.size(); n++) {
+      delete sensors[n];
+      delete chips[n];
+    }
+  }
+
+  std::vector<TwoWire> wires;
+  std::vector<HostTSL2561 *> chips;
+  std::vector<Adafruit_TSL2561_Unified *> sensors;
+  std::vector<tsl2561SharedSample_t> samples;
+  std::vector<Adafruit_TSL2561_BusWorker *> workers;
+};
+
+/* Samples per second with one thread taking turns on every bus */
+static double oneThread(Rig *rig) {
+  uint32_t read = 0;
+  uint32_t start = millis();
+  while (millis() - start < BENCH_MS) {
+    for (Adafruit_TSL2561_BusWorker *worker : rig->workers)
+      read += worker->run();
+  }
+  return read * 1000.0 / (millis() - start);
+}
+
+/* Samples per second with a thread per bus, while this thread reads */
+static double threadPerBus(Rig *rig, uint32_t *snapshots) {
+  std::atomic<bool> stop(false);
+  std::atomic<uint32_t> read(0);
+  std::vector<std::thread> threads;
+
+  uint32_t start = millis();
+  for (Adafruit_TSL2561_BusWorker *worker : rig->workers) {
+    threads.emplace_back([&stop, &read, worker] {
+      while (!stop)
+        read += worker->run();
+    });
+  }
+  *snapshots = 0;
+  while (millis() - start < BENCH_MS) {
+    for (const tsl2561SharedSample_t &sample : rig->samples) {
+      uint16_t broadband, ir;
+      Adafruit_TSL2561_BusWorker::readShared(&sample, &broadband, &ir, NULL);
+      (*snapshots)++;
+    }
+  }
+  stop = true;
+  for (std::thread &thread : threads)
+    thread.join();
+  return read * 1000.0 / (millis() - start);
+}
+
+/* One publisher, several readers, one sample. Every publish is a
+   consistent set of fields, so a copy that mixes two is torn */
+static uint32_t torture(uint32_t *publishes, uint32_t *reads) {
+  tsl2561SharedSample_t sample = {};
+  std::atomic<bool> stop(false);
+  std::atomic<uint32_t> torn(0), copies(0);
+  std::vector<std::thread> readers;
+
+  /* A zeroed sample isn't a consistent one: publish before reading */
+  Adafruit_TSL2561_BusWorker::publish(&sample, true, 0, 0xffff, 0);
+  for (uint8_t r = 0; r < BENCH_READERS; r++) {
+    readers.emplace_back([&] {
+      uint32_t mine = 0;
+      while (!stop) {
+        uint16_t broadband, ir;
+        uint32_t timestamp;
+        bool valid = Adafruit_TSL2561_BusWorker::readShared(
+            &sample, &broadband, &ir, &timestamp);
+        if ((ir != (uint16_t)~broadband) ||
+            (timestamp != (uint32_t)broadband * 3) ||
+            (valid != !(broadband & 1)))
+          torn++;
+        mine++;
+      }
+      copies += mine;
+    });
+  }
+
+  uint32_t start = millis(), n = 0;
+  while (millis() - start < BENCH_TORTURE_MS) {
+    for (uint16_t i = 0; i < 1000; i++, n++) {
+      uint16_t broadband = (uint16_t)n;
+      Adafruit_TSL2561_BusWorker::publish(&sample, !(broadband & 1), broadband,
+                                          (uint16_t)~broadband,
+                                          (uint32_t)broadband * 3);
+    }
+  }
+  stop = true;
+  for (std::thread &reader : readers)
+    reader.join();
+
+  *publishes = n;
+  *reads = copies;
+  return torn;
+}
+
+int main(void) {
+  static const uint8_t busCounts[] = {1, 2, 4};
+  int failed = 0;
+
+  hostSetRealTime(true);
+  printf("%u sensors per bus, 13ms, 100kHz, %u hardware threads\n",
+         BENCH_PER_BUS, std::thread::hardware_concurrency());
+  printf("%-6s %14s %16s %18s\n", "buses", "one thread/s", "thread per bus/s",
+         "snapshot reads/s");
+  for (uint8_t buses : busCounts) {
+    Rig rig(buses);
+    double single = oneThread(&rig);
+    uint32_t snapshots;
+    double parallel = threadPerBus(&rig, &snapshots);
+    printf("%-6u %14.0f %16.0f %18.0f\n", buses, single, parallel,
+           snapshots * 1000.0 / BENCH_MS);
+  }
+
+  uint32_t publishes, reads;
+  uint32_t torn = torture(&publishes, &reads);
+  printf("seqlock: %u publishes, %u reads by %u readers, %u torn\n",
+         publishes, reads, BENCH_READERS, torn);
+  if (torn)
+    failed = 1;
+
+  hostSetRealTime(false);
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,121 @@
+/*!
+ * @file daynight.cpp
+ *
+ * Adafruit_TSL2561_Engine::setAdaptiveInterval() replayed over a simulated
+ * 24 hour day (simulated time): night, a sine-squared dawn, day and dusk
+ * at 101ms and 1x, with 0.1% sensor noise and 18 passing clouds that cut
+ * the light to 30% for 4 minutes each around midday. At 1s/60s/20 counts
+ * the engine must fall back to 1s at both edges of every cloud, never
+ * while the light only ramps at dawn and dusk, and take a small fraction
+ * of the samples polling every second would. The day is generated here,
+ * not recorded from a sensor outdoors.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <math.h>
+#include <stdio.h>
+
+#define DAY_MS (24UL * 3600 * 1000) ///< Length of the trace
+#define HOUR_MS (3600UL * 1000)     ///< One hour
+#define DAY_STEP_MS (10)            ///< Time between update() calls
+
+#define DAY_PEAK (20.0)             ///< Broadband counts per ms at noon, 1x
+#define DAY_NIGHT (0.02)            ///< Broadband counts per ms at night
+#define DAY_NOISE (0.001)           ///< Sensor noise, as a share of the light
+#define DAY_CLOUDS (18)             ///< Clouds between 9:30 and 14:30
+#define DAY_CLOUD_MS (240000UL)     ///< How long a cloud covers the sun
+#define DAY_CLOUD_EVERY (1000000UL) ///< Time between clouds
+#define DAY_CLOUD_SHADE (0.3)       ///< Share of the light under a cloud
+
+#define DAY_MIN_MS (1000)  ///< Interval while the light changes
+#define DAY_MAX_MS (60000) ///< Longest interval while it is steady
+#define DAY_CHANGE (20)    ///< Broadband counts treated as a change
+#define DAY_MAX_SAMPLES (DAY_MS / DAY_MIN_MS / 20) ///< 5% of polling
+
+static const uint32_t firstCloud = 9 * HOUR_MS + HOUR_MS / 2;
+
+/* Light at a time of day, before noise */
+static double lightAt(uint32_t ms) {
+  double sun = sin((ms / (double)HOUR_MS - 6) / 12 * M_PI);
+  if (sun <= 0)
+    return DAY_NIGHT;
+  double light = DAY_NIGHT + DAY_PEAK * sun * sun;
+  if ((ms >= firstCloud) &&
+      ((ms - firstCloud) / DAY_CLOUD_EVERY < DAY_CLOUDS) &&
+      ((ms - firstCloud) % DAY_CLOUD_EVERY < DAY_CLOUD_MS))
+    light *= DAY_CLOUD_SHADE;
+  return light;
+}
+
+/* Uniform in [-1, 1], the same sequence on every run */
+static double noise(void) {
+  static uint32_t state = 1;
+  state = state * 1664525UL + 1013904223UL;
+  return (state >> 8) / (double)(1UL << 23) - 1;
+}
+
+/* Dawn and dusk, where the light only ramps */
+static bool ramping(uint32_t ms) {
+  return ((ms >= 6 * HOUR_MS) && (ms < 9 * HOUR_MS)) ||
+         ((ms >= 15 * HOUR_MS) && (ms < 18 * HOUR_MS));
+}
+
+int main(void) {
+  HostTSL2561 chip;
+  TwoWire bus;
+  bus.attach(&chip);
+
+  Adafruit_TSL2561_Unified tsl(TSL2561_ADDR_FLOAT);
+  tsl.begin(&bus);
+  tsl.setIntegrationTime(TSL2561_INTEGRATIONTIME_101MS);
+  tsl.setGain(TSL2561_GAIN_1X);
+
+  uint32_t edges[2 * DAY_CLOUDS];
+  for (uint8_t i = 0; i < DAY_CLOUDS; i++) {
+    edges[2 * i] = firstCloud + i * DAY_CLOUD_EVERY;
+    edges[2 * i + 1] = edges[2 * i] + DAY_CLOUD_MS;
+  }
+
+  hostResetClock();
+  Adafruit_TSL2561_Engine engine(&tsl);
+  engine.setAdaptiveInterval(DAY_MIN_MS, DAY_MAX_MS, DAY_CHANGE);
+
+  uint8_t nextEdge = 0, caught = 0;
+  uint32_t rampFast = 0;
+  uint32_t start = millis();
+  while (millis() - start < DAY_MS) {
+    uint32_t now = millis() - start;
+    chip.light = lightAt(now) * (1 + DAY_NOISE * noise());
+    if (engine.update()) {
+      bool fast = (engine.getInterval() == DAY_MIN_MS);
+      /* The first sample after a cloud edge must see it */
+      bool edge = false;
+      while ((nextEdge < 2 * DAY_CLOUDS) && (edges[nextEdge] <= now)) {
+        nextEdge++;
+        edge = true;
+      }
+      if (edge && fast)
+        caught++;
+      else if (edge)
+        printf("FAILED: missed the cloud edge before %.2fh\n",
+               now / (double)HOUR_MS);
+      if (ramping(now) && fast)
+        rampFast++;
+    }
+    delay(DAY_STEP_MS);
+  }
+
+  uint32_t samples = engine.getSampleCount();
+  printf("24h at %u-%ums, %u counts: %u samples, %u saved against every "
+         "%ums\n",
+         DAY_MIN_MS, DAY_MAX_MS, DAY_CHANGE, samples, engine.getSamplesSaved(),
+         DAY_MIN_MS);
+  printf("cloud edges caught: %u of %u, fast samples on the ramps: %u\n",
+         caught, 2 * DAY_CLOUDS, rampFast);
+
+  int failed = 0;
+  if ((caught != 2 * DAY_CLOUDS) || rampFast || (samples > DAY_MAX_SAMPLES))
+    failed = 1;
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
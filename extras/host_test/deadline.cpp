@@ -0,0 +1,280 @@
+/*!
+ * @file deadline.cpp
+ *
+ * getLuxWithin() and getLuxHDR() against their budget on the simulated
+ * bus, where every transaction takes bus time. Sweeps budgets, light
+ * levels and retry policies while NACKing runs of transactions at every
+ * point of the call, and fails if any call takes longer than its budget,
+ * leaves the sensor on other settings than it was given, or returns a
+ * value after the bus stopped answering part way through. Every value
+ * returned must match the simulated light to within its precision, and a
+ * fault-free call by a caller that knows the light level must use the
+ * finest plan that fits its budget without clipping and report that
+ * plan's precision. Calls that cannot get a reading in time (a deadline
+ * miss) must return false within the budget; how many did is reported per
+ * retry policy.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <math.h>
+#include <stdio.h>
+
+/* What the sensor is set to outside the call: 101ms, 1x */
+#define DEADLINE_TIMING (0x01)
+
+/* Channel 1 as a share of channel 0 in the simulated light */
+#define DEADLINE_IR_FRACTION (0.3)
+
+/* Share of the true lux a value may be off by besides its precision: the
+   channel scale factors round the integration time ratios by up to 0.25% */
+#define DEADLINE_LUX_SHARE (0.005)
+
+/* Gain/integration plans in the order getLuxWithin() prefers them */
+static const uint8_t plans[] = {0x12, 0x11, 0x02, 0x10, 0x01, 0x00};
+
+struct Policy {
+  uint8_t retries;
+  uint8_t backoff;
+};
+
+struct Outcome {
+  bool ok;
+  uint32_t elapsed;
+  uint32_t transfers;
+  bool restored;
+  uint32_t lux;
+  uint32_t precision; ///< getLuxWithin() only
+  uint8_t timing;     ///< TIMING the last conversion of the call ran on
+};
+
+/* Lux the library's model gives for the simulated light, without count
+   truncation: broadband at 402ms/16x, with the IR share in the
+   0.25..0.375 ratio segment of the T, FN and CL package */
+static double trueLux(double light) {
+  return light * 402 * 16 *
+         (TSL2561_LUX_B3T - TSL2561_LUX_M3T * DEADLINE_IR_FRACTION) /
+         (1 << TSL2561_LUX_LUXSCALE);
+}
+
+/* Counts the simulator returns for light on a plan */
+static uint16_t planCounts(double light, uint8_t timing) {
+  static const double integrationMs[] = {13.7, 101, 402};
+  static const uint16_t fullScale[] = {5047, 37177, 65535};
+  double value = light * integrationMs[timing & 0x03] *
+                 ((timing & 0x10) ? 16 : 1);
+  if (value > fullScale[timing & 0x03])
+    return fullScale[timing & 0x03];
+  return (uint16_t)value;
+}
+
+static uint32_t planDelay(uint8_t timing) {
+  static const uint32_t delays[] = {TSL2561_DELAY_INTTIME_13MS,
+                                    TSL2561_DELAY_INTTIME_101MS,
+                                    TSL2561_DELAY_INTTIME_402MS};
+  return delays[timing & 0x03];
+}
+
+/* The finest plan that fits the budget and stays under the auto-gain
+   threshold at light, or -1 if every plan that fits would clip */
+static int bestPlan(uint32_t budget, double light) {
+  static const uint16_t thresholds[] = {
+      TSL2561_AGC_THI_13MS, TSL2561_AGC_THI_101MS, TSL2561_AGC_THI_402MS};
+  for (uint8_t plan : plans) {
+    if (planDelay(plan) + TSL2561_DELAY_CONVERSION_BUS > budget)
+      continue;
+    if (planCounts(light, plan) <= thresholds[plan & 0x03])
+      return plan;
+  }
+  return -1;
+}
+
+/* Milli-lux one count of broadband is worth on a plan at light */
+static uint32_t planPrecision(double light, uint8_t timing) {
+  HostTSL2561 chip;
+  TwoWire bus;
+  bus.attach(&chip);
+  Adafruit_TSL2561_Unified tsl(0x39, 1);
+  tsl.begin(&bus);
+  tsl.setIntegrationTime((tsl2561IntegrationTime_t)(timing & 0x03));
+  tsl.setGain((tsl2561Gain_t)(timing & 0x10));
+
+  uint16_t broadband = planCounts(light, timing);
+  uint16_t ir = planCounts(light * DEADLINE_IR_FRACTION, timing);
+  return tsl.calculateLuxQ(broadband + 1, ir) -
+         tsl.calculateLuxQ(broadband, ir);
+}
+
+/* One getLuxWithin() or getLuxHDR() call on a fresh sensor, NACKing count
+   transactions from the first'th on */
+static Outcome run(bool hdr, uint32_t budget, double light, bool warm,
+                   uint32_t first, uint32_t count) {
+  HostTSL2561 chip;
+  chip.light = light;
+  chip.irFraction = DEADLINE_IR_FRACTION;
+  TwoWire bus;
+  bus.attach(&chip);
+
+  Adafruit_TSL2561_Unified tsl(0x39, 1);
+  tsl.begin(&bus);
+  tsl.setIntegrationTime(TSL2561_INTEGRATIONTIME_101MS);
+  tsl.setGain(TSL2561_GAIN_1X);
+
+  uint32_t lux, precision;
+  /* Learn the light level, as a repeated caller would have: a call that
+     clipped only tells the next one to start coarse */
+  for (int i = 0; warm && (i < 3); i++)
+    if (tsl.getLuxWithin(TSL2561_DELAY_INTTIME_402MS + 10, &lux, &precision))
+      break;
+
+  Outcome outcome;
+  precision = 0;
+  chip.nackAfter(first, count);
+  uint32_t start = millis();
+  uint32_t transfers = chip.transfers;
+  outcome.ok = hdr ? tsl.getLuxHDR(&lux, budget)
+                   : tsl.getLuxWithin(budget, &lux, &precision);
+  outcome.elapsed = millis() - start;
+  outcome.transfers = chip.transfers - transfers;
+  outcome.lux = lux;
+  outcome.precision = precision;
+  outcome.timing = chip.regs[0x01] & 0x13;
+  chip.nackAfter(0, 0);
+
+  /* The next conversion must run on the user's settings again */
+  uint16_t broadband, ir;
+  tsl.startConversion();
+  tsl.readConversion(&broadband, &ir);
+  outcome.restored = ((chip.regs[0x01] & 0x13) == DEADLINE_TIMING);
+  return outcome;
+}
+
+/* Every budget, light level and NACK run under each retry policy */
+static int sweep(bool hdr) {
+  static const Policy policies[] = {{0, 0}, {3, 20}, {2, 5}, {5, 2}};
+  static const uint32_t budgets[] = {10,  16,  20,  50,  121, 122,
+                                     130, 200, 451, 452, 500};
+  static const double lights[] = {0.05, 5, 100, 2000, 100000};
+  static const uint32_t counts[] = {1, 2, 3, 1000};
+  int failed = 0;
+
+  printf("%-14s %7s %7s %7s %7s %9s %9s\n",
+         hdr ? "getLuxHDR" : "getLuxWithin", "calls", "valid", "missed",
+         "wrong", "overruns", "worst");
+  for (const Policy &policy : policies) {
+    Adafruit_TSL2561_Unified::setBusRetries(policy.retries, policy.backoff);
+    uint32_t calls = 0, valid = 0, overruns = 0, wrong = 0;
+    double worst = 0;
+
+    for (uint32_t budget : budgets) {
+      for (double light : lights) {
+        for (int warm = 0; warm < 2; warm++) {
+          /* No faults, then every run of NACKs at every transaction */
+          for (uint32_t first = 0; first <= 12; first++) {
+            for (uint32_t count : counts) {
+              Outcome outcome =
+                  first ? run(hdr, budget, light, warm, first - 1, count)
+                        : run(hdr, budget, light, warm, 0, 0);
+              calls++;
+              valid += outcome.ok;
+              double used = (double)outcome.elapsed / budget;
+              if (used > worst)
+                worst = used;
+              if (outcome.elapsed > budget) {
+                if (overruns++ < 5)
+                  printf("OVERRUN: budget %u took %u (light %g, %s, NACK "
+                         "%u from %u)\n",
+                         budget, outcome.elapsed, light,
+                         warm ? "warm" : "cold", count, first);
+                failed = 1;
+              }
+              if (!outcome.restored) {
+                printf("NOT RESTORED: budget %u, light %g, NACK %u from %u\n",
+                       budget, light, count, first);
+                failed = 1;
+              }
+              /* Without retries, a bus that stops answering for good may
+                 only have cost a call with a value its final power-down */
+              if (!policy.retries && (count == 1000) && outcome.ok &&
+                  (outcome.transfers > first)) {
+                printf("VALUE WITHOUT BUS: budget %u, light %g, NACK from "
+                       "%u of %u\n",
+                       budget, light, first, outcome.transfers);
+                failed = 1;
+              }
+              if (outcome.ok) {
+                /* Truncating to whole counts costs up to a count either
+                   way. getLuxHDR() reports no precision; its short
+                   exposure is the coarsest it takes. */
+                uint32_t precision = hdr ? planPrecision(light, 0x00)
+                                         : outcome.precision;
+                double error = fabs(outcome.lux - trueLux(light));
+                if (error > trueLux(light) * DEADLINE_LUX_SHARE +
+                                precision / 1000.0 + 1) {
+                  if (wrong++ < 5)
+                    printf("WRONG LUX: %u for %.1f (budget %u, precision "
+                           "%u, NACK %u from %u)\n",
+                           outcome.lux, trueLux(light), budget, precision,
+                           count, first);
+                  failed = 1;
+                }
+              }
+              /* Knowing the light level, a fault-free call gets the
+                 finest plan the budget allows. A budget a plan fits to
+                 the millisecond may lose it to a clock tick, so it is
+                 only held to plans that fit either way. */
+              int plan = bestPlan(budget, light);
+              if (!hdr && warm && !first && (plan >= 0) &&
+                  (plan == bestPlan(budget - 1, light))) {
+                uint32_t expected = planPrecision(light, (uint8_t)plan);
+                if (!outcome.ok || (outcome.timing != plan) ||
+                    (outcome.precision + 1 < expected) ||
+                    (outcome.precision > expected + 1)) {
+                  printf("NOT THE BEST PLAN: budget %u, light %g got 0x%02x "
+                         "at %u, want 0x%02x at %u\n",
+                         budget, light, outcome.timing, outcome.precision,
+                         plan, expected);
+                  failed = 1;
+                }
+              }
+              if (!first)
+                break;
+            }
+          }
+        }
+      }
+    }
+
+    char name[16];
+    snprintf(name, sizeof(name), "%u x %ums", policy.retries, policy.backoff);
+    printf("%-14s %7u %7u %7u %7u %9u %8.0f%%\n", name, calls, valid,
+           calls - valid, wrong, overruns, worst * 100);
+  }
+  return failed;
+}
+
+int main(void) {
+  int failed = sweep(false);
+  failed |= sweep(true);
+
+  /* 2 NACKs with 3 retries backing off 20ms, against a 130ms budget */
+  Adafruit_TSL2561_Unified::setBusRetries(3, 20);
+  uint32_t worst = 0, valid = 0, cases = 0;
+  for (int warm = 0; warm < 2; warm++) {
+    for (uint32_t first = 0; first < 12; first++) {
+      Outcome outcome = run(false, 130, 100, warm, first, 2);
+      if (outcome.elapsed > worst)
+        worst = outcome.elapsed;
+      valid += outcome.ok;
+      cases++;
+    }
+  }
+  printf("130ms budget, 2 NACKs anywhere, 3 x 20ms retries: %u/%u valid, "
+         "slowest %ums\n",
+         valid, cases, worst);
+  if (worst > 130)
+    failed = 1;
+
+  Adafruit_TSL2561_Unified::setBusRetries(0, 0);
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
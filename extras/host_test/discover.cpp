@@ -0,0 +1,58 @@
+/*!
+ * @file discover.cpp
+ *
+ * discover() on a bus with TSL2561s at the low and float addresses, and at
+ * the high address a device whose ID register names another part. The two
+ * sensors must fill the first two slots, ready to read, and every slot past
+ * them must be left byte for byte as it was, including the one the failed
+ * probe of the high address was tried in.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SLOTS 4
+
+static int failed = 0;
+
+#define CHECK(cond, ...)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      printf("FAILED: " __VA_ARGS__);                                          \
+      printf("\n");                                                            \
+      failed = 1;                                                              \
+    }                                                                          \
+  } while (0)
+
+int main(void) {
+  HostTSL2561 low(TSL2561_ADDR_LOW), floating(TSL2561_ADDR_FLOAT);
+  HostTSL2561 other(TSL2561_ADDR_HIGH, 0x90);
+  Wire.attach(&low);
+  Wire.attach(&floating);
+  Wire.attach(&other);
+
+  Adafruit_TSL2561_Unified sensors[SLOTS];
+  unsigned char before[SLOTS][sizeof(Adafruit_TSL2561_Unified)];
+  memcpy(before, (const void *)sensors, sizeof(before));
+
+  uint8_t found = Adafruit_TSL2561_Unified::discover(&Wire, sensors, SLOTS);
+  printf("found %u of 2\n", found);
+  CHECK(found == 2, "discover() found %u sensors", found);
+
+  for (uint8_t i = found; i < SLOTS; i++)
+    CHECK(!memcmp(before[i], (const void *)&sensors[i], sizeof(before[i])),
+          "slot %u changed", i);
+
+  for (uint8_t i = 0; i < found; i++) {
+    uint16_t broadband, ir;
+    sensors[i].getLuminosity(&broadband, &ir);
+    CHECK(broadband > 0, "sensor %u read %u", i, broadband);
+  }
+  CHECK(low.powerUps && floating.powerUps && !other.powerUps,
+        "power-ups %u/%u/%u", low.powerUps, floating.powerUps,
+        other.powerUps);
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
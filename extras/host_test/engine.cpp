@@ -0,0 +1,78 @@
+/*!
+ * @file engine.cpp
+ *
+ * Adafruit_TSL2561_Engine listeners that call peek() on the engine that
+ * is notifying them. While the light steps through dark, bright and
+ * saturating levels and back, so that thresholds are crossed and readings
+ * clip, every sample, saturation and threshold event must find the
+ * sample it carries already cached, as a TSL2561_EVENT_SAMPLE with the
+ * same readings and timestamp.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <stdio.h>
+
+#define ENGINE_LOW (50)    ///< Lower threshold, in lux
+#define ENGINE_HIGH (2000) ///< Upper threshold, in lux
+
+static Adafruit_TSL2561_Engine *engine;
+static uint32_t seen[TSL2561_EVENT_ERROR + 1];
+static int failed = 0;
+
+static void listener(const tsl2561Event_t *event, void *context) {
+  (void)context;
+  tsl2561Event_t cached;
+  seen[event->type]++;
+  if (!engine->peek(&cached)) {
+    printf("FAILED: event %u for %u/%u, nothing to peek()\n", event->type,
+           event->broadband, event->ir);
+    failed = 1;
+  } else if ((cached.type != TSL2561_EVENT_SAMPLE) ||
+             (cached.broadband != event->broadband) ||
+             (cached.ir != event->ir) || (cached.level != event->level) ||
+             (cached.timestamp != event->timestamp)) {
+    printf("FAILED: event %u for %u/%u, peek() gave type %u, %u/%u\n",
+           event->type, event->broadband, event->ir, cached.type,
+           cached.broadband, cached.ir);
+    failed = 1;
+  }
+}
+
+int main(void) {
+  HostTSL2561 chip;
+  TwoWire bus;
+  bus.attach(&chip);
+
+  Adafruit_TSL2561_Unified tsl(TSL2561_ADDR_FLOAT);
+  tsl.begin(&bus);
+  tsl.setIntegrationTime(TSL2561_INTEGRATIONTIME_13MS);
+  tsl.setGain(TSL2561_GAIN_16X);
+
+  Adafruit_TSL2561_Engine sensorEngine(&tsl);
+  engine = &sensorEngine;
+  sensorEngine.setInterval(20);
+  sensorEngine.setThresholds(ENGINE_LOW, ENGINE_HIGH);
+  sensorEngine.subscribe(listener, NULL,
+                         TSL2561_EVENT_SAMPLE | TSL2561_EVENT_THRESHOLD |
+                             TSL2561_EVENT_SATURATED);
+
+  static const double lights[] = {1, 200, 20000, 200, 1, 20000, 1};
+  for (double light : lights) {
+    chip.light = light;
+    uint8_t samples = 0;
+    while (samples < 3) {
+      samples += sensorEngine.update();
+      delay(1);
+    }
+  }
+
+  printf("%u samples, %u threshold and %u saturation events\n",
+         seen[TSL2561_EVENT_SAMPLE], seen[TSL2561_EVENT_THRESHOLD],
+         seen[TSL2561_EVENT_SATURATED]);
+  if (!seen[TSL2561_EVENT_THRESHOLD] || !seen[TSL2561_EVENT_SATURATED]) {
+    printf("FAILED: the light steps didn't cross a threshold and clip\n");
+    failed = 1;
+  }
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,227 @@
+/*!
+ * @file equivalence.cpp
+ *
+ * Exhaustive check of Adafruit_TSL2561_Unified::calculateLux() against the
+ * frozen reference in reference_lux.cpp: every broadband and IR value, at
+ * every integration time and gain, for the package the driver was built
+ * for (build twice, with and without TSL2561_PACKAGE_CS, for both).
+ *
+ * Work is split into rows (one broadband value at one time/gain setting)
+ * handed out to threads. Progress is checkpointed as the number of rows
+ * below which everything is done, so an interrupted run resumes where it
+ * left off. On a mismatch the first one in enumeration order is reported.
+ *
+ * Usage: equivalence [-j threads] [-c checkpoint] [-s stride] [-i seconds]
+ *   -s  check every stride-th broadband and IR value (quick runs)
+ *   -i  checkpoint interval, default 10s
+ */
+#include "reference_lux.h"
+#include <Adafruit_TSL2561_U.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#ifdef TSL2561_PACKAGE_CS
+static const bool packageCS = true;
+#else
+static const bool packageCS = false;
+#endif
+
+static const uint32_t settings = 6; /* 3 integration times x 2 gains */
+static const uint32_t rows = settings * 65536;
+
+static uint32_t stride = 1;
+static std::atomic<uint32_t> nextRow(0);
+static std::atomic<uint64_t> checked(0);
+
+/* Completed rows, and the first mismatch */
+static std::mutex progressMutex;
+static std::vector<bool> rowDone;
+static uint32_t doneBelow = 0;
+static bool mismatch = false;
+static uint32_t mismatchRow = 0xFFFFFFFF;
+static uint16_t mismatchIr;
+static uint32_t mismatchExpected, mismatchGot;
+
+static void decodeRow(uint32_t row, uint16_t *broadband, uint8_t *time,
+                      bool *gain16) {
+  uint32_t setting = row / 65536;
+  *broadband = row % 65536;
+  *time = setting / 2;
+  *gain16 = setting % 2;
+}
+
+static void worker(void) {
+  for (;;) {
+    uint32_t row = nextRow.fetch_add(1);
+    if (row >= rows)
+      return;
+    {
+      std::lock_guard<std::mutex> lock(progressMutex);
+      if (mismatch && (row > mismatchRow))
+        return;
+    }
+
+    uint16_t broadband;
+    uint8_t time;
+    bool gain16;
+    decodeRow(row, &broadband, &time, &gain16);
+
+    uint64_t count = 0;
+    if (broadband % stride == 0) {
+      for (uint32_t ir = 0; ir < 65536; ir += stride) {
+        uint32_t expected =
+            referenceLux(broadband, ir, time, gain16, packageCS);
+        uint32_t got = Adafruit_TSL2561_Unified::calculateLux(
+            broadband, ir, (tsl2561IntegrationTime_t)time,
+            gain16 ? TSL2561_GAIN_16X : TSL2561_GAIN_1X);
+        count++;
+        if (got != expected) {
+          std::lock_guard<std::mutex> lock(progressMutex);
+          if (row < mismatchRow) {
+            mismatch = true;
+            mismatchRow = row;
+            mismatchIr = ir;
+            mismatchExpected = expected;
+            mismatchGot = got;
+          }
+          break;
+        }
+      }
+    }
+    checked += count;
+
+    std::lock_guard<std::mutex> lock(progressMutex);
+    rowDone[row] = true;
+    while ((doneBelow < rows) && rowDone[doneBelow])
+      doneBelow++;
+  }
+}
+
+static uint32_t loadCheckpoint(const char *path) {
+  uint32_t row = 0;
+  unsigned int savedStride;
+  FILE *f = fopen(path, "r");
+  if (!f)
+    return 0;
+  if ((fscanf(f, "%u %u", &row, &savedStride) != 2) ||
+      (savedStride != stride) || (row > rows))
+    row = 0;
+  fclose(f);
+  return row;
+}
+
+static void saveCheckpoint(const char *path, uint32_t row) {
+  char tmp[512];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE *f = fopen(tmp, "w");
+  if (!f)
+    return;
+  fprintf(f, "%u %u\n", row, stride);
+  fclose(f);
+  rename(tmp, path);
+}
+
+int main(int argc, char **argv) {
+  unsigned int threads = std::thread::hardware_concurrency();
+  const char *checkpoint = NULL;
+  unsigned int interval = 10;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "j:c:s:i:")) != -1) {
+    switch (opt) {
+    case 'j':
+      threads = atoi(optarg);
+      break;
+    case 'c':
+      checkpoint = optarg;
+      break;
+    case 's':
+      stride = atoi(optarg);
+      break;
+    case 'i':
+      interval = atoi(optarg);
+      break;
+    default:
+      fprintf(stderr, "usage: %s [-j threads] [-c checkpoint] [-s stride] "
+                      "[-i seconds]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if (threads < 1)
+    threads = 1;
+  if (stride < 1)
+    stride = 1;
+
+  rowDone.assign(rows, false);
+  uint32_t start = checkpoint ? loadCheckpoint(checkpoint) : 0;
+  for (uint32_t r = 0; r < start; r++)
+    rowDone[r] = true;
+  doneBelow = start;
+  nextRow = start;
+
+  printf("calculateLux() vs reference, %s package, stride %u, %u threads, "
+         "resuming at row %u of %u\n",
+         packageCS ? "CS" : "T/FN/CL", stride, threads, start, rows);
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> pool;
+  for (unsigned int i = 0; i < threads; i++)
+    pool.push_back(std::thread(worker));
+
+  /* Checkpoint and report while the workers run */
+  for (;;) {
+    uint32_t below;
+    for (unsigned int waited = 0; waited < interval * 10; waited++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+      std::lock_guard<std::mutex> lock(progressMutex);
+      if ((doneBelow >= rows) || (mismatch && doneBelow >= mismatchRow))
+        break;
+    }
+    bool finished;
+    {
+      std::lock_guard<std::mutex> lock(progressMutex);
+      below = doneBelow;
+      finished = (below >= rows) || (mismatch && below >= mismatchRow);
+    }
+    if (checkpoint && !mismatch)
+      saveCheckpoint(checkpoint, below);
+    double secs = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - t0)
+                      .count();
+    printf("  %5.1f%%  %.3g cases/s\n", 100.0 * below / rows,
+           checked / (secs > 0 ? secs : 1));
+    fflush(stdout);
+    if (finished)
+      break;
+  }
+  for (unsigned int i = 0; i < pool.size(); i++)
+    pool[i].join();
+
+  double secs =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+          .count();
+  if (mismatch) {
+    uint16_t broadband;
+    uint8_t time;
+    bool gain16;
+    decodeRow(mismatchRow, &broadband, &time, &gain16);
+    printf("FIRST MISMATCH: broadband %u ir %u time %u gain %s: reference %u, "
+           "calculateLux() %u\n",
+           broadband, mismatchIr, time, gain16 ? "16x" : "1x",
+           mismatchExpected, mismatchGot);
+    return 1;
+  }
+
+  printf("OK: %llu cases in %.1fs, no mismatch\n",
+         (unsigned long long)checked.load(), secs);
+  if (checkpoint)
+    saveCheckpoint(checkpoint, rows);
+  return 0;
+}
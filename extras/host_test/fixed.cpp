@@ -0,0 +1,170 @@
+/*!
+ * @file fixed.cpp
+ *
+ * Adafruit_TSL2561_Fixed against Adafruit_TSL2561_Unified. For each of the
+ * six integration time and gain pairs and both packages, in one build, its
+ * calculateLux() must match the original lux math on every IR value for a
+ * spread of broadband values. Two fixed sensors with different addresses
+ * and settings share one simulated bus and must each read their own chip
+ * with their own timing, a NACK must be retried as setBusRetries() says,
+ * and an instance must hold nothing but its bus pointer.
+ */
+#include "reference_lux.h"
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <stdio.h>
+
+#define FIXED_STRIDE (61) ///< Broadband values checked: every 61st, and 0xFFFF
+
+static int failed = 0;
+
+/* Mismatches over every IR value for one broadband value */
+template <tsl2561IntegrationTime_t Time, tsl2561Gain_t Gain,
+          tsl2561Package_t Package>
+static uint32_t compareAt(uint16_t broadband) {
+  typedef Adafruit_TSL2561_Fixed<TSL2561_ADDR_FLOAT, Time, Gain, Package>
+      Fixed;
+  uint32_t mismatches = 0;
+
+  for (uint32_t ir = 0; ir <= 0xFFFF; ir++) {
+    uint32_t expected =
+        referenceLux(broadband, (uint16_t)ir, Time, Gain == TSL2561_GAIN_16X,
+                     Package == TSL2561_PACKAGE_TYPE_CS);
+    uint32_t got = Fixed::calculateLux(broadband, (uint16_t)ir);
+    if ((got != expected) && (mismatches++ < 5))
+      printf("MISMATCH: time %d gain 0x%02x package %d b %u ir %u: %u, "
+             "expected %u\n",
+             Time, Gain, Package, broadband, ir, got, expected);
+  }
+  return mismatches;
+}
+
+template <tsl2561IntegrationTime_t Time, tsl2561Gain_t Gain,
+          tsl2561Package_t Package>
+static void compare(void) {
+  uint32_t mismatches = compareAt<Time, Gain, Package>(0xFFFF);
+
+  for (uint32_t b = 0; b <= 0xFFFF; b += FIXED_STRIDE)
+    mismatches += compareAt<Time, Gain, Package>((uint16_t)b);
+  if (mismatches)
+    failed = 1;
+  printf("time %d, gain 0x%02x, package %d: %u mismatches\n", Time, Gain,
+         Package, mismatches);
+}
+
+template <tsl2561Package_t Package> static void comparePackage(void) {
+  compare<TSL2561_INTEGRATIONTIME_13MS, TSL2561_GAIN_1X, Package>();
+  compare<TSL2561_INTEGRATIONTIME_13MS, TSL2561_GAIN_16X, Package>();
+  compare<TSL2561_INTEGRATIONTIME_101MS, TSL2561_GAIN_1X, Package>();
+  compare<TSL2561_INTEGRATIONTIME_101MS, TSL2561_GAIN_16X, Package>();
+  compare<TSL2561_INTEGRATIONTIME_402MS, TSL2561_GAIN_1X, Package>();
+  compare<TSL2561_INTEGRATIONTIME_402MS, TSL2561_GAIN_16X, Package>();
+}
+
+int main(void) {
+  comparePackage<TSL2561_PACKAGE_TYPE_T_FN_CL>();
+  comparePackage<TSL2561_PACKAGE_TYPE_CS>();
+
+  /* Two sensors with different settings on one bus */
+  HostTSL2561 low(TSL2561_ADDR_LOW), high(TSL2561_ADDR_HIGH);
+  low.light = 20;
+  high.light = 300;
+  TwoWire bus;
+  bus.attach(&low);
+  bus.attach(&high);
+
+  Adafruit_TSL2561_Fixed<TSL2561_ADDR_LOW, TSL2561_INTEGRATIONTIME_101MS,
+                         TSL2561_GAIN_16X>
+      dim;
+  Adafruit_TSL2561_Fixed<TSL2561_ADDR_HIGH, TSL2561_INTEGRATIONTIME_13MS,
+                         TSL2561_GAIN_1X>
+      bright;
+  Adafruit_TSL2561_Fixed<TSL2561_ADDR_FLOAT, TSL2561_INTEGRATIONTIME_13MS,
+                         TSL2561_GAIN_1X>
+      absent;
+  if (!dim.begin(&bus) || !bright.begin(&bus) || absent.begin(&bus)) {
+    printf("FAILED: begin() found the wrong sensors\n");
+    failed = 1;
+  }
+
+  /* What the driver reads from the same chips with the same settings */
+  Adafruit_TSL2561_Unified dimRef(TSL2561_ADDR_LOW);
+  Adafruit_TSL2561_Unified brightRef(TSL2561_ADDR_HIGH);
+  uint16_t dimB, dimIR, brightB, brightIR;
+  dimRef.begin(&bus);
+  dimRef.setIntegrationTime(TSL2561_INTEGRATIONTIME_101MS);
+  dimRef.setGain(TSL2561_GAIN_16X);
+  dimRef.getLuminosity(&dimB, &dimIR);
+  brightRef.begin(&bus);
+  brightRef.setIntegrationTime(TSL2561_INTEGRATIONTIME_13MS);
+  brightRef.setGain(TSL2561_GAIN_1X);
+  brightRef.getLuminosity(&brightB, &brightIR);
+  low.regs[0x01] = high.regs[0x01] = 0x02; /* Power-on default */
+
+  uint16_t broadband, ir;
+  uint32_t start = millis();
+  bool ok = dim.getLuminosity(&broadband, &ir);
+  uint32_t took = millis() - start;
+  if (!ok || ((low.regs[0x01] & 0x13) != 0x11) ||
+      (broadband != dimB) || (ir != dimIR) ||
+      (took < TSL2561_DELAY_INTTIME_101MS)) {
+    printf("FAILED: 101ms/16x sensor read %u (driver %u) in %ums, timing "
+           "0x%02x\n",
+           broadband, dimB, took, low.regs[0x01]);
+    failed = 1;
+  }
+  if (low.regs[0x00] & 0x03) {
+    printf("FAILED: sensor left powered\n");
+    failed = 1;
+  }
+
+  uint32_t lux;
+  start = millis();
+  ok = bright.getLux(&lux);
+  took = millis() - start;
+  if (!ok || ((high.regs[0x01] & 0x13) != 0x00) ||
+      (lux != brightRef.calculateLux(brightB, brightIR)) ||
+      (took >= TSL2561_DELAY_INTTIME_101MS)) {
+    printf("FAILED: 13ms/1x sensor read %u lux in %ums, timing 0x%02x\n", lux,
+           took, high.regs[0x01]);
+    failed = 1;
+  }
+  printf("two fixed sensors on one bus: %u counts at 101ms/16x, %u lux at "
+         "13ms/1x\n",
+         broadband, lux);
+
+  /* A bus fault reads as zeros */
+  low.nackAfter(2, 1);
+  broadband = ir = 1;
+  if (dim.getLuminosity(&broadband, &ir) || broadband || ir) {
+    printf("FAILED: NACKed read returned %u/%u\n", broadband, ir);
+    failed = 1;
+  }
+
+  /* unless the driver's retry policy gets it through: NACK the IR
+     channel's data, then expect the transactions of a reading and that
+     channel's two again */
+#ifdef TSL2561_FOLD_TIMING
+  const uint32_t reading = 6;
+#else
+  const uint32_t reading = 7;
+#endif
+  Adafruit_TSL2561_Unified::setBusRetries(1, 0);
+  low.nackAfter(reading - 2, 1);
+  uint32_t transfers = low.transfers;
+  if (!dim.getLuminosity(&broadband, &ir) || (broadband != dimB) ||
+      (low.transfers - transfers != reading + 2)) {
+    printf("FAILED: retried read returned %u/%u in %u transactions\n",
+           broadband, ir, low.transfers - transfers);
+    failed = 1;
+  }
+  Adafruit_TSL2561_Unified::setBusRetries(0, 0);
+
+  if (sizeof(dim) != sizeof(TwoWire *)) {
+    printf("FAILED: instance is %u bytes\n", (unsigned)sizeof(dim));
+    failed = 1;
+  }
+
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
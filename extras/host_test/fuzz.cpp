@@ -0,0 +1,195 @@
+/*!
+ * @file fuzz.cpp
+ *
+ * libFuzzer target for the driver's handling of I2C responses. The fuzz
+ * input picks the chip's ID register, the light level and the settings,
+ * then decides the fate of every transaction in turn: passed through to
+ * a simulated TSL2561, NACKed, cut short, replaced with garbage or
+ * returned with one bit flipped. begin(), getLuminosity() with auto-gain
+ * and getEvent() run against that, and the target aborts if a result
+ * breaks the driver's contract (sanitizer reports abort it too).
+ *
+ * Build with -fsanitize=fuzzer for libFuzzer, or link fuzz_main.cpp to
+ * run it without one.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Fate of one transaction, from the low 3 bits of its control byte */
+#define FUZZ_NACK (4)    ///< Nobody acknowledges
+#define FUZZ_SHORT (5)   ///< Fewer bytes than asked for
+#define FUZZ_GARBAGE (6) ///< Reply bytes come from the fuzz input
+#define FUZZ_FLIP (7)    ///< One bit of the transfer flipped
+/* 0-3 pass the transaction through unchanged */
+
+/** Reads the fuzz input front to back; zeros once it runs out */
+class FuzzInput {
+public:
+  FuzzInput(const uint8_t *data, size_t size) : _data(data), _left(size) {}
+
+  bool empty(void) const { return !_left; }
+  uint8_t next(void) {
+    if (!_left)
+      return 0;
+    _left--;
+    return *_data++;
+  }
+
+private:
+  const uint8_t *_data;
+  size_t _left;
+};
+
+/** A simulated TSL2561 whose transactions the fuzz input tampers with */
+class FuzzTSL2561 : public HostTSL2561 {
+public:
+  FuzzTSL2561(FuzzInput *input, uint8_t partId)
+      : HostTSL2561(0x39, partId), validIdSent(false), _input(input) {}
+
+  bool i2cWrite(const uint8_t *data, uint8_t len) {
+    uint8_t control = _input->next();
+    switch (control & 0x07) {
+    case FUZZ_NACK:
+      return false;
+    case FUZZ_FLIP:
+      if (len) {
+        uint8_t copy[HOST_I2C_BUFFER];
+        memcpy(copy, data, len);
+        copy[(control >> 3) % len] ^= 1 << (_input->next() & 0x07);
+        return HostTSL2561::i2cWrite(copy, len);
+      }
+      break;
+    }
+    return HostTSL2561::i2cWrite(data, len);
+  }
+
+  uint8_t i2cRead(uint8_t *data, uint8_t len) {
+    uint8_t control = _input->next();
+    uint8_t got;
+
+    switch (control & 0x07) {
+    case FUZZ_NACK:
+      return 0;
+    case FUZZ_SHORT:
+      HostTSL2561::i2cRead(data, len);
+      got = len ? (control >> 3) % len : 0;
+      break;
+    case FUZZ_GARBAGE:
+      for (uint8_t i = 0; i < len; i++)
+        data[i] = _input->next();
+      got = len;
+      break;
+    case FUZZ_FLIP:
+      got = HostTSL2561::i2cRead(data, len);
+      if (got)
+        data[(control >> 3) % got] ^= 1 << (_input->next() & 0x07);
+      break;
+    default:
+      got = HostTSL2561::i2cRead(data, len);
+      break;
+    }
+
+    /* A complete one-byte read that looks like a TSL2561's ID register. The
+       register is not checked: a flipped command byte can make any register
+       answer the driver's ID read */
+    if ((got == 1) && (len == 1) &&
+        (((data[0] >> 4) == 0x1) || ((data[0] >> 4) == 0x5)))
+      validIdSent = true;
+    return got;
+  }
+
+  bool validIdSent; ///< The driver was ever shown a TSL2561's part number
+
+private:
+  FuzzInput *_input;
+};
+
+/* Reports a broken contract, then aborts so the input is kept */
+#define FUZZ_CHECK(cond)                                                       \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fprintf(stderr, "fuzz: %s failed at line %d\n", #cond, __LINE__);      \
+      abort();                                                                 \
+    }                                                                          \
+  } while (0)
+
+#ifndef TSL2561_NO_UNIFIED_SENSOR
+/* The brightest lux any reading converts to. It can exceed 65536 (e.g. at
+   13ms and 1x), so that value only means saturated when getEvent() says so */
+static uint32_t maxLux(void) {
+  static const tsl2561IntegrationTime_t times[] = {
+      TSL2561_INTEGRATIONTIME_13MS, TSL2561_INTEGRATIONTIME_101MS,
+      TSL2561_INTEGRATIONTIME_402MS};
+  static const tsl2561Gain_t gains[] = {TSL2561_GAIN_1X, TSL2561_GAIN_16X};
+  uint32_t most = 0;
+
+  for (uint8_t t = 0; t < 3; t++) {
+    for (uint8_t g = 0; g < 2; g++) {
+      for (uint32_t b = 0; b <= 0xFFFF; b++) {
+        uint32_t lux = Adafruit_TSL2561_Unified::calculateLux(
+            (uint16_t)b, 0, times[t], gains[g]);
+        if ((lux != 65536) && (lux > most))
+          most = lux;
+      }
+    }
+  }
+  return most;
+}
+#endif
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  static const tsl2561IntegrationTime_t times[] = {
+      TSL2561_INTEGRATIONTIME_13MS, TSL2561_INTEGRATIONTIME_101MS,
+      TSL2561_INTEGRATIONTIME_402MS, TSL2561_INTEGRATIONTIME_402MS};
+
+  FuzzInput input(data, size);
+  uint8_t partId = input.next();
+  /* Integration time (bits 0-1), retry backoff (2), health checks (3) and
+     retries (6-7) */
+  uint8_t settings = input.next();
+  uint16_t light = input.next();
+  light |= input.next() << 8;
+  uint8_t irShare = input.next();
+
+  hostResetClock();
+  Adafruit_TSL2561_Unified::setBusRetries(settings >> 6, settings & 0x04);
+
+  FuzzTSL2561 chip(&input, partId);
+  chip.light = light / 16.0;
+  chip.irFraction = irShare / 255.0;
+  TwoWire bus;
+  bus.attach(&chip);
+
+  Adafruit_TSL2561_Unified tsl(0x39, 1);
+  bool found = tsl.begin(&bus);
+  /* Only a TSL2561's part number may make begin() succeed */
+  FUZZ_CHECK(!found || chip.validIdSent);
+
+  tsl.enableAutoRange(true);
+  tsl.setIntegrationTime(times[settings & 0x03]);
+#ifdef TSL2561_WITH_HEALTH
+  tsl.setHealthCheckInterval((settings & 0x08) ? 1 : 0);
+#endif
+
+  /* Keep going while there are faults left to inject */
+  for (uint8_t round = 0; (round < 4) && !input.empty(); round++) {
+    uint16_t broadband = 0xFFFF, ir = 0xFFFF;
+    tsl.getLuminosity(&broadband, &ir);
+    /* A failed reading is reported as zeros, never as stale or torn data */
+    FUZZ_CHECK(!tsl.getBusFault() || (!broadband && !ir));
+
+#ifndef TSL2561_NO_UNIFIED_SENSOR
+    static const uint32_t brightest = maxLux();
+    sensors_event_t event;
+    bool ok = tsl.getEvent(&event);
+    FUZZ_CHECK(event.light == event.light);
+    FUZZ_CHECK((event.light >= 0) && (event.light <= brightest));
+    FUZZ_CHECK(!ok || (event.light != 65536));
+#endif
+  }
+
+  Adafruit_TSL2561_Unified::setBusRetries(0, 0);
+  return 0;
+}
@@ -0,0 +1,152 @@
+/*!
+ * @file fuzz_main.cpp
+ *
+ * Runs the fuzz target without libFuzzer, for compilers that don't have
+ * it (e.g. g++ with -fsanitize=address,undefined). With file arguments it
+ * replays those inputs, e.g. a crash libFuzzer saved; otherwise it feeds
+ * random inputs for a number of runs or seconds and reports executions
+ * per second. An input that crashes is written to crash-<run> first.
+ *
+ *   fuzz [-n runs] [-t seconds] [-l max_len] [-r seed] [file...]
+ */
+#include <chrono>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Sanitizer reports exit without a signal; have them save the input too */
+#if defined(__SANITIZE_ADDRESS__)
+#define FUZZ_HAVE_SANITIZER
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define FUZZ_HAVE_SANITIZER
+#endif
+#endif
+#ifdef FUZZ_HAVE_SANITIZER
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+#define FUZZ_MAX_LEN (4096) ///< Largest input the runner generates
+
+static uint8_t current[FUZZ_MAX_LEN];
+static size_t currentSize;
+static char crashName[32] = "crash";
+
+/* Keeps the input that was running; only async-signal-safe calls */
+static void saveCurrent(void) {
+  int fd = open(crashName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return;
+  if (write(fd, current, currentSize) < 0) {
+  }
+  close(fd);
+  static const char note[] = "fuzz: input saved to ";
+  if (write(2, note, sizeof(note) - 1) < 0 ||
+      write(2, crashName, strlen(crashName)) < 0 || write(2, "\n", 1) < 0) {
+  }
+}
+
+static void onSignal(int sig) {
+  saveCurrent();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+/* xorshift64*: fast, and the same inputs for the same seed */
+static uint64_t nextRandom(uint64_t *state) {
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+static int replay(const char *path) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    perror(path);
+    return 1;
+  }
+  currentSize = fread(current, 1, sizeof(current), f);
+  fclose(f);
+  LLVMFuzzerTestOneInput(current, currentSize);
+  printf("%s: %u bytes, ok\n", path, (unsigned)currentSize);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned long runs = 0, seconds = 10, maxLen = 64;
+  uint64_t seed = 1;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:t:l:r:")) != -1) {
+    switch (opt) {
+    case 'n':
+      runs = strtoul(optarg, NULL, 0);
+      seconds = 0;
+      break;
+    case 't':
+      seconds = strtoul(optarg, NULL, 0);
+      break;
+    case 'l':
+      maxLen = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      seed = strtoull(optarg, NULL, 0);
+      break;
+    default:
+      fprintf(stderr,
+              "usage: %s [-n runs] [-t seconds] [-l max_len] [-r seed] "
+              "[file...]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+  if ((maxLen < 1) || (maxLen > FUZZ_MAX_LEN))
+    maxLen = FUZZ_MAX_LEN;
+
+  if (optind < argc) {
+    int failed = 0;
+    for (int i = optind; i < argc; i++)
+      failed |= replay(argv[i]);
+    return failed;
+  }
+
+  signal(SIGABRT, onSignal);
+  signal(SIGSEGV, onSignal);
+#ifdef FUZZ_HAVE_SANITIZER
+  __sanitizer_set_death_callback(saveCurrent);
+#endif
+
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  double elapsed = 0;
+  uint64_t state = seed ? seed : 1;
+  unsigned long run;
+
+  for (run = 0; runs ? (run < runs) : (elapsed < seconds); run++) {
+    snprintf(crashName, sizeof(crashName), "crash-%lu", run);
+    currentSize = nextRandom(&state) % (maxLen + 1);
+    for (size_t i = 0; i < currentSize; i++)
+      current[i] = (uint8_t)(nextRandom(&state) >> 56);
+    LLVMFuzzerTestOneInput(current, currentSize);
+
+    if (!(run & 0x3FF)) {
+      elapsed = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    }
+  }
+  elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                          start)
+                .count();
+
+  printf("%lu runs in %.1fs, %.0f exec/s, max_len %lu, seed %llu\n", run,
+         elapsed, run / elapsed, maxLen, (unsigned long long)seed);
+  return 0;
+}
@@ -0,0 +1,114 @@
+/*!
+ * @file lock_stress.cpp
+ *
+ * Two sensors on one simulated bus, shared between std::threads on real
+ * time: for each sensor one thread reads events with auto-gain on while
+ * another keeps changing its integration time and gain. Built with
+ * TSL2561_BUS_LOCK, through Adafruit_TSL2561_Locked<std::mutex>, no
+ * transaction may overlap another on the bus and every event must hold
+ * the sensor's light level. Built without it (lock_stress_unlocked), the
+ * same threads use the sensors directly, and the overlaps and bad events
+ * are only reported, to show what the lock prevents.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#define STRESS_MS (1000)      ///< How long the threads run
+#define STRESS_TOLERANCE (15) ///< Percent an event may be off the light
+
+#ifdef TSL2561_BUS_LOCK
+typedef Adafruit_TSL2561_Locked<std::mutex> Sensor; ///< What threads call
+#else
+typedef Adafruit_TSL2561_Unified Sensor; ///< What threads call
+#endif
+
+/* Reads events until told to stop, counting those off the expected lux */
+static void reader(Sensor *sensor, float expected, std::atomic<bool> *stop,
+                   std::atomic<uint32_t> *events, std::atomic<uint32_t> *bad) {
+  while (!*stop) {
+    sensors_event_t event;
+    bool ok = sensor->getEvent(&event);
+    (*events)++;
+    if (!ok || (event.light < expected * (100 - STRESS_TOLERANCE) / 100) ||
+        (event.light > expected * (100 + STRESS_TOLERANCE) / 100))
+      (*bad)++;
+  }
+}
+
+/* Changes the settings every few milliseconds until told to stop */
+static void configurer(Sensor *sensor, std::atomic<bool> *stop) {
+  for (uint32_t i = 0; !*stop; i++) {
+    sensor->setIntegrationTime((tsl2561IntegrationTime_t)(i % 2));
+    sensor->setGain((i % 3) ? TSL2561_GAIN_1X : TSL2561_GAIN_16X);
+    std::this_thread::sleep_for(std::chrono::milliseconds(3));
+  }
+}
+
+int main(void) {
+  HostTSL2561 chip0(TSL2561_ADDR_LOW), chip1(TSL2561_ADDR_FLOAT);
+  TwoWire bus;
+  bus.attach(&chip0);
+  bus.attach(&chip1);
+  chip0.light = 40;
+  chip1.light = 90;
+
+  Adafruit_TSL2561_Unified tsl0(TSL2561_ADDR_LOW, 0);
+  Adafruit_TSL2561_Unified tsl1(TSL2561_ADDR_FLOAT, 1);
+#ifdef TSL2561_BUS_LOCK
+  std::mutex busMutex;
+  Sensor sensor0(&tsl0, &busMutex), sensor1(&tsl1, &busMutex);
+  Sensor *sensors[2] = {&sensor0, &sensor1};
+#else
+  Sensor *sensors[2] = {&tsl0, &tsl1};
+#endif
+  int failed = 0;
+
+  /* What every event should be, read before the threads start */
+  float expected[2];
+  for (uint8_t i = 0; i < 2; i++) {
+    sensors_event_t event;
+    if (!sensors[i]->begin(&bus) || !sensors[i]->getEvent(&event)) {
+      printf("FAILED: sensor %u not read\n", i);
+      return 1;
+    }
+    expected[i] = event.light;
+    sensors[i]->enableAutoRange(true);
+  }
+
+  hostSetRealTime(true);
+  bus.resetCounters();
+  std::atomic<bool> stop(false);
+  std::atomic<uint32_t> events(0), bad(0);
+  std::vector<std::thread> threads;
+  for (uint8_t i = 0; i < 2; i++) {
+    threads.emplace_back(reader, sensors[i], expected[i], &stop, &events,
+                         &bad);
+    threads.emplace_back(configurer, sensors[i], &stop);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(STRESS_MS));
+  stop = true;
+  for (std::thread &thread : threads)
+    thread.join();
+  hostSetRealTime(false);
+
+  printf("%s: %u events, %u bad, %u transactions, %u overlapped\n",
+#ifdef TSL2561_BUS_LOCK
+         "locked",
+#else
+         "unlocked",
+#endif
+         events.load(), bad.load(), bus.transactions.load(),
+         bus.collisions.load());
+#ifdef TSL2561_BUS_LOCK
+  if (!events || bad || bus.collisions)
+    failed = 1;
+#endif
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
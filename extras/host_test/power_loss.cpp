@@ -0,0 +1,136 @@
+/*!
+ * @file power_loss.cpp
+ *
+ * Reset detection and recovery against a simulated TSL2561 that browns
+ * out: its registers go back to their power-on values (powered down,
+ * 402ms at 1x) between two conversions, in the middle of one, or while it
+ * is off the bus for a while. The sensor runs at 101ms and 16x, so any
+ * reading taken on the reset settings shows. For each health check
+ * interval and each point of loss, the readings taken on the wrong
+ * settings must stay within what the interval allows, the settings must
+ * come back without a begin(), and the recovery must be counted.
+ */
+#include "sim.h"
+#include <Adafruit_TSL2561_U.h>
+#include <stdio.h>
+
+#define LOSS_TIMING (0x11) ///< 101ms, 16x: what the driver is set to
+#define LOSS_READINGS (24) ///< Conversions per run
+
+/* How the sensor loses power */
+enum LossKind {
+  LOSS_BETWEEN, ///< Between two conversions
+  LOSS_DURING,  ///< After startConversion(), before readConversion()
+  LOSS_OUTAGE   ///< Off the bus for 3 transactions, then back reset
+};
+
+static const char *const kindNames[] = {"between", "during", "outage"};
+
+struct Result {
+  uint8_t wrong;      ///< Readings that weren't on the sensor's settings
+  uint8_t recoveries; ///< getRecoveryCount() at the end
+  uint16_t recoveryMs;
+  bool restored; ///< TIMING holds the driver's settings at the end
+  uint32_t begins;
+};
+
+static Result run(uint8_t interval, LossKind kind, uint8_t lossAt) {
+  HostTSL2561 chip;
+  chip.light = 50;
+  Wire.detachAll();
+  Wire.attach(&chip);
+
+  Adafruit_TSL2561_Unified tsl(0x39);
+  tsl.begin();
+  tsl.setIntegrationTime(TSL2561_INTEGRATIONTIME_101MS);
+  tsl.setGain(TSL2561_GAIN_16X);
+  tsl.setHealthCheckInterval(interval);
+
+  /* What every reading should be */
+  uint16_t expected, expectedIR;
+  tsl.getLuminosity(&expected, &expectedIR);
+  Wire.resetCounters();
+
+  Result result = {0, 0, 0, false, 0};
+  for (uint8_t i = 0; i < LOSS_READINGS; i++) {
+    uint16_t broadband = 0, ir = 0;
+    if (i == lossAt) {
+      if (kind == LOSS_OUTAGE)
+        chip.nackAfter(0, 3);
+      if (kind != LOSS_DURING)
+        chip.powerLoss();
+    }
+    if ((i == lossAt) && (kind == LOSS_DURING)) {
+      tsl.startConversion();
+      chip.powerLoss();
+      tsl.readConversion(&broadband, &ir);
+    } else {
+      tsl.getLuminosity(&broadband, &ir);
+    }
+    /* A bus fault is reported as such, not as a reading */
+    if (!tsl.getBusFault() && (broadband != expected))
+      result.wrong++;
+  }
+
+  result.recoveries = tsl.getRecoveryCount();
+  result.recoveryMs = tsl.getLastRecoveryTime();
+  result.restored = ((chip.regs[0x01] & 0x13) == LOSS_TIMING);
+  result.begins = Wire.begins;
+  return result;
+}
+
+int main(void) {
+  static const uint8_t intervals[] = {1, 2, 4, 10};
+  int failed = 0;
+
+  printf("%-9s %8s %6s %12s %10s\n", "loss", "interval", "runs",
+         "worst wrong", "worst ms");
+  for (uint8_t k = LOSS_BETWEEN; k <= LOSS_OUTAGE; k++) {
+    LossKind kind = (LossKind)k;
+    for (uint8_t interval : intervals) {
+      uint8_t worstWrong = 0;
+      uint16_t worstMs = 0;
+      uint32_t runs = 0;
+
+      /* Leave room after the loss for the next check to come round */
+      for (uint8_t lossAt = 0; lossAt + interval + 2 < LOSS_READINGS;
+           lossAt++) {
+        Result result = run(interval, kind, lossAt);
+        runs++;
+
+        /* Readings on the reset settings: at most until the next check,
+           plus the one the loss cut short */
+        uint8_t allowed = interval - 1 + (kind == LOSS_DURING);
+        if ((result.wrong > allowed) || (result.recoveries != 1) ||
+            !result.restored || result.begins) {
+          printf("FAILED: %s, interval %u, loss at %u: %u wrong readings, "
+                 "%u recoveries, %s, %u begin()\n",
+                 kindNames[kind], interval, lossAt, result.wrong,
+                 result.recoveries,
+                 result.restored ? "restored" : "not restored",
+                 result.begins);
+          failed = 1;
+        }
+        if (result.wrong > worstWrong)
+          worstWrong = result.wrong;
+        if (result.recoveryMs > worstMs)
+          worstMs = result.recoveryMs;
+      }
+      printf("%-9s %8u %6u %12u %10u\n", kindNames[kind], interval, runs,
+             worstWrong, worstMs);
+    }
+  }
+
+  /* Without periodic checks a silent reset is only found on request */
+  Result unchecked = run(0, LOSS_BETWEEN, 2);
+  printf("no checks, reset at 2: %u of %u readings wrong, %u recoveries\n",
+         unchecked.wrong, LOSS_READINGS - 2, unchecked.recoveries);
+  if (unchecked.recoveries || (unchecked.wrong != LOSS_READINGS - 2)) {
+    printf("FAILED: an unchecked sensor noticed the reset\n");
+    failed = 1;
+  }
+
+  Wire.detachAll();
+  printf(failed ? "FAILED\n" : "OK\n");
+  return failed;
+}
@@ -0,0 +1,25 @@
+/*!
+ * @file reference_lux.h
+ *
+ * Frozen copy of the lux calculation as it stood before any optimization
+ * (Adafruit_TSL2561_Unified::calculateLux() in the baseline release), used
+ * as the oracle by equivalence.cpp. Do not change it to match the driver.
+ */
+#ifndef HOST_REFERENCE_LUX_H
+#define HOST_REFERENCE_LUX_H
+
+#include <stdint.h>
+
+/*!
+    @brief  Baseline lux calculation
+    @param  broadband Channel 0 counts
+    @param  ir Channel 1 counts
+    @param  time TIMING integration bits (0-2)
+    @param  gain16 True for 16x gain
+    @param  cs True for the CS package coefficients, false for T/FN/CL
+    @returns Lux, or 65536 if either channel is clipped
+*/
+uint32_t referenceLux(uint16_t broadband, uint16_t ir, uint8_t time,
+                      bool gain16, bool cs);
+
+#endif
@@ -0,0 +1,151 @@
+/*!
+ * @file sim.cpp
+ *
+ * Simulated TSL2561 and TCA9548A.
+ */
+#include "sim.h"
+
+/* TIMING register bits */
+#define SIM_INTEG_MASK (0x03)
+#define SIM_GAIN_16X (0x10)
+
+HostTSL2561::HostTSL2561(uint8_t addr, uint8_t partId)
+    : HostI2CDevice(addr), light(100.0), irFraction(0.3), id(partId),
+      powerUps(0), transfers(0), _nackFrom(0), _nackCount(0) {
+  powerLoss();
+}
+
+void HostTSL2561::nackAfter(uint32_t first, uint32_t count) {
+  _nackFrom = transfers + first;
+  _nackCount = count;
+}
+
+bool HostTSL2561::nackThis(void) {
+  uint32_t n = transfers++;
+  return _nackCount && (n >= _nackFrom) && (n - _nackFrom < _nackCount);
+}
+
+void HostTSL2561::powerLoss(void) {
+  memset(regs, 0, sizeof(regs));
+  regs[0x01] = 0x02; /* TIMING: 402ms, 1x */
+  pointer = 0;
+  poweredAt = 0;
+}
+
+uint16_t HostTSL2561::counts(bool ir) {
+  static const uint32_t integrationUs[] = {13700, 101000, 402000};
+  static const uint16_t fullScale[] = {5047, 37177, 65535};
+
+  uint8_t time = regs[0x01] & SIM_INTEG_MASK;
+  if ((regs[0x00] & 0x03) != 0x03)
+    return 0;
+  if (time > 2) /* Manual integration, not simulated */
+    return 0;
+  if ((uint32_t)(micros() - poweredAt) < integrationUs[time])
+    return 0;
+
+  double value = light * (ir ? irFraction : 1.0) * integrationUs[time] / 1000.0;
+  if (regs[0x01] & SIM_GAIN_16X)
+    value *= 16;
+  if (value > fullScale[time])
+    return fullScale[time];
+  return (uint16_t)value;
+}
+
+bool HostTSL2561::i2cWrite(const uint8_t *data, uint8_t len) {
+  if (nackThis())
+    return false;
+  if (!len)
+    return true;
+
+  /* The command bit must be set; anything else is not a valid command */
+  if (!(data[0] & 0x80))
+    return false;
+  pointer = data[0] & 0x0F;
+
+  for (uint8_t i = 1; i < len; i++) {
+    uint8_t reg = pointer & 0x0F;
+    if (reg == 0x00) {
+      bool wasOn = ((regs[0x00] & 0x03) == 0x03);
+      bool on = ((data[i] & 0x03) == 0x03);
+      if (on && !wasOn) {
+        poweredAt = micros();
+        powerUps++;
+      }
+    }
+    if ((reg != 0x0A) && (reg < 0x0C))
+      regs[reg] = data[i];
+    pointer++;
+  }
+  return true;
+}
+
+uint8_t HostTSL2561::i2cRead(uint8_t *data, uint8_t len) {
+  if (nackThis())
+    return 0;
+  for (uint8_t i = 0; i < len; i++) {
+    uint8_t reg = pointer & 0x0F;
+    uint16_t value;
+    switch (reg) {
+    case 0x0A:
+      data[i] = id;
+      break;
+    case 0x0C:
+    case 0x0D:
+      value = counts(false);
+      data[i] = (reg == 0x0C) ? (value & 0xFF) : (value >> 8);
+      break;
+    case 0x0E:
+    case 0x0F:
+      value = counts(true);
+      data[i] = (reg == 0x0E) ? (value & 0xFF) : (value >> 8);
+      break;
+    default:
+      data[i] = regs[reg];
+      break;
+    }
+    pointer++;
+  }
+  return len;
+}
+
+HostTCA9548A::HostTCA9548A(uint8_t addr)
+    : HostI2CDevice(addr), control(0), selects(0), nackChannels(0) {
+  memset(_childCount, 0, sizeof(_childCount));
+}
+
+void HostTCA9548A::attach(uint8_t channel, HostI2CDevice *device) {
+  if ((channel < 8) && (_childCount[channel] < 4))
+    _children[channel][_childCount[channel]++] = device;
+}
+
+HostI2CDevice *HostTCA9548A::find(uint8_t addr) {
+  if (addr == address)
+    return this;
+  for (uint8_t c = 0; c < 8; c++) {
+    if (!(control & (1 << c)))
+      continue;
+    for (uint8_t i = 0; i < _childCount[c]; i++) {
+      HostI2CDevice *device = _children[c][i]->find(addr);
+      if (device)
+        return device;
+    }
+  }
+  return NULL;
+}
+
+bool HostTCA9548A::i2cWrite(const uint8_t *data, uint8_t len) {
+  if (len && (data[len - 1] & nackChannels))
+    return false;
+  if (len) {
+    control = data[len - 1];
+    selects++;
+  }
+  return true;
+}
+
+uint8_t HostTCA9548A::i2cRead(uint8_t *data, uint8_t len) {
+  for (uint8_t i = 0; i < len; i++)
+    data[i] = control;
+  return len;
+}
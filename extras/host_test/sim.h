@@ -0,0 +1,66 @@
+/*!
+ * @file sim.h
+ *
+ * Simulated TSL2561 and TCA9548A mux for the host tests. The TSL2561
+ * follows the datasheet register protocol (command bit, byte and word
+ * transfers with auto-increment) and only returns counts once an
+ * integration has completed since power-up.
+ */
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <Wire.h>
+
+#define SIM_TSL2561_ID (0x50) ///< ID register of a TSL2561T, revision 0
+
+/** A TSL2561 at one address */
+class HostTSL2561 : public HostI2CDevice {
+public:
+  explicit HostTSL2561(uint8_t addr = 0x39, uint8_t id = SIM_TSL2561_ID);
+
+  bool i2cWrite(const uint8_t *data, uint8_t len);
+  uint8_t i2cRead(uint8_t *data, uint8_t len);
+
+  /** Brown-out: back to the power-on register values, powered down */
+  void powerLoss(void);
+  /** What the ADC would hold now for channel 0, or channel 1 if ir */
+  uint16_t counts(bool ir);
+  /** NACK count transactions, starting with the first'th from now */
+  void nackAfter(uint32_t first, uint32_t count);
+
+  double light;      ///< Broadband counts per ms of integration at 1x gain
+  double irFraction; ///< Channel 1 as a share of channel 0
+  uint8_t id;        ///< Value of the ID register
+  uint8_t regs[16];  ///< Register file
+  uint8_t pointer;   ///< Register the next read starts at
+  uint32_t poweredAt; ///< micros() of the last power-up
+  uint32_t powerUps;  ///< CONTROL writes that powered the chip up
+  uint32_t transfers; ///< Transactions addressed to the chip
+
+private:
+  bool nackThis(void);
+
+  uint32_t _nackFrom;
+  uint32_t _nackCount;
+};
+
+/** A TCA9548A: one control byte selecting any of 8 downstream channels */
+class HostTCA9548A : public HostI2CDevice {
+public:
+  explicit HostTCA9548A(uint8_t addr = 0x70);
+
+  void attach(uint8_t channel, HostI2CDevice *device);
+  HostI2CDevice *find(uint8_t addr);
+  bool i2cWrite(const uint8_t *data, uint8_t len);
+  uint8_t i2cRead(uint8_t *data, uint8_t len);
+
+  uint8_t control;  ///< Channels enabled, one bit each
+  uint32_t selects; ///< Control writes
+  uint8_t nackChannels; ///< Channels whose select is NACKed, one bit each
+
+private:
+  HostI2CDevice *_children[8][4];
+  uint8_t _childCount[8];
+};
+
+#endif
@@ -0,0 +1,48 @@
+/*!
+ * @file Adafruit_Sensor.h
+ *
+ * The parts of the Adafruit Unified Sensor library the TSL2561 driver uses,
+ * for host builds.
+ */
+#ifndef HOST_ADAFRUIT_SENSOR_H
+#define HOST_ADAFRUIT_SENSOR_H
+
+#include <stdint.h>
+
+#define SENSOR_TYPE_LIGHT (5)
+
+/** Sensor event, light only */
+typedef struct {
+  int32_t version;
+  int32_t sensor_id;
+  int32_t type;
+  int32_t reserved0;
+  int32_t timestamp;
+  union {
+    float data[4];
+    float light;
+  };
+} sensors_event_t;
+
+/** Sensor details */
+typedef struct {
+  char name[12];
+  int32_t version;
+  int32_t sensor_id;
+  int32_t type;
+  float max_value;
+  float min_value;
+  float resolution;
+  int32_t min_delay;
+} sensor_t;
+
+/** Unified sensor base class */
+class Adafruit_Sensor {
+public:
+  virtual ~Adafruit_Sensor() {}
+  virtual void enableAutoRange(bool enabled) { (void)enabled; }
+  virtual bool getEvent(sensors_event_t *) = 0;
+  virtual void getSensor(sensor_t *) = 0;
+};
+
+#endif
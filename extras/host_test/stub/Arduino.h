@@ -0,0 +1,32 @@
+/*!
+ * @file Arduino.h
+ *
+ * Minimal host stand-in for the Arduino core, enough to build the TSL2561
+ * driver on Linux for the tests and benchmarks in extras/host_test.
+ *
+ * Time is virtual by default: delay() advances the clock instantly, so
+ * long traces run in seconds and every run is deterministic. Threaded
+ * tests switch to the real clock with hostSetRealTime(true).
+ */
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef bool boolean;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+/* Host only */
+void hostSetRealTime(bool real);
+bool hostRealTime(void);
+void hostResetClock(void);
+void hostBusTime(uint32_t us);
+
+#endif
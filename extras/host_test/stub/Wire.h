@@ -0,0 +1,89 @@
+/*!
+ * @file Wire.h
+ *
+ * Host TwoWire: the Arduino API the driver uses, in front of simulated
+ * devices. Like the real library it has a single transmit and receive
+ * buffer per bus, so unsynchronised users corrupt each other's
+ * transactions. Each call is atomic; a call on a buffer another thread
+ * filled (the interleaving that corrupts a real bus) counts a collision.
+ */
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <Arduino.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#define HOST_I2C_MAX_DEVICES (16) ///< Devices attached directly to a bus
+#define HOST_I2C_BUFFER (32)      ///< Bytes per transaction, as on AVR
+
+/** A simulated device on a bus */
+class HostI2CDevice {
+public:
+  explicit HostI2CDevice(uint8_t addr) : address(addr) {}
+  virtual ~HostI2CDevice() {}
+
+  /** The device that answers at addr, e.g. behind a mux */
+  virtual HostI2CDevice *find(uint8_t addr) {
+    return (addr == address) ? this : NULL;
+  }
+  /** A write transaction; false to NACK it */
+  virtual bool i2cWrite(const uint8_t *data, uint8_t len) = 0;
+  /** A read transaction; returns the number of bytes supplied */
+  virtual uint8_t i2cRead(uint8_t *data, uint8_t len) = 0;
+
+  uint8_t address;
+};
+
+class TwoWire {
+public:
+  TwoWire();
+
+  void begin(void) { begins++; }
+  void beginTransmission(uint8_t addr);
+  void beginTransmission(int addr) { beginTransmission((uint8_t)addr); }
+  size_t write(uint8_t value);
+  uint8_t endTransmission(bool stop = true);
+  uint8_t requestFrom(uint8_t addr, uint8_t len);
+  uint8_t requestFrom(int addr, int len) {
+    return requestFrom((uint8_t)addr, (uint8_t)len);
+  }
+  int read(void);
+  int available(void);
+
+  /* Host only */
+  void attach(HostI2CDevice *device);
+  void detachAll(void);
+  void failNext(uint16_t count) { _failNext = count; }
+  void shortReadNext(uint16_t count) { _shortNext = count; }
+  void resetCounters(void);
+
+  uint32_t byteTimeUs;                ///< Bus time per byte, 90us at 100kHz
+  std::atomic<uint32_t> begins;       ///< begin() calls
+  std::atomic<uint32_t> transactions; ///< Writes plus reads
+  std::atomic<uint32_t> bytes;        ///< Bytes on the bus, addresses included
+  std::atomic<uint32_t> nacks;        ///< Transactions nobody acknowledged
+  std::atomic<uint32_t> collisions;   ///< Transactions that overlapped
+
+private:
+  HostI2CDevice *find(uint8_t addr);
+
+  std::mutex _mutex;
+  HostI2CDevice *_devices[HOST_I2C_MAX_DEVICES];
+  uint8_t _deviceCount;
+  uint8_t _txAddr;
+  uint8_t _tx[HOST_I2C_BUFFER];
+  uint8_t _txLen;
+  std::thread::id _txThread;
+  std::thread::id _rxThread;
+  uint8_t _rx[HOST_I2C_BUFFER];
+  uint8_t _rxLen;
+  uint8_t _rxPos;
+  uint16_t _failNext;
+  uint16_t _shortNext;
+};
+
+extern TwoWire Wire;
+
+#endif
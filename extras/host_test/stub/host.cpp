@@ -0,0 +1,171 @@
+/*!
+ * @file host.cpp
+ *
+ * Clock and TwoWire for the host stub.
+ */
+#include <Wire.h>
+#include <chrono>
+#include <thread>
+
+/*========================================================================*/
+/*                                 CLOCK                                  */
+/*========================================================================*/
+
+static std::atomic<uint64_t> virtualMicros(0);
+static std::atomic<bool> realTime(false);
+static const std::chrono::steady_clock::time_point realStart =
+    std::chrono::steady_clock::now();
+
+void hostSetRealTime(bool real) { realTime = real; }
+
+bool hostRealTime(void) { return realTime; }
+
+void hostResetClock(void) { virtualMicros = 0; }
+
+static uint64_t nowMicros(void) {
+  if (!realTime)
+    return virtualMicros;
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - realStart)
+      .count();
+}
+
+unsigned long millis(void) { return (unsigned long)(nowMicros() / 1000); }
+
+unsigned long micros(void) { return (unsigned long)nowMicros(); }
+
+void delayMicroseconds(unsigned int us) {
+  if (realTime)
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  else
+    virtualMicros += us;
+}
+
+void delay(unsigned long ms) { delayMicroseconds(ms * 1000); }
+
+/* Time a transaction keeps the bus busy */
+void hostBusTime(uint32_t us) { delayMicroseconds(us); }
+
+/*========================================================================*/
+/*                                TWOWIRE                                 */
+/*========================================================================*/
+
+TwoWire Wire;
+
+TwoWire::TwoWire()
+    : byteTimeUs(90), begins(0), transactions(0), bytes(0), nacks(0),
+      collisions(0), _deviceCount(0), _txAddr(0), _txLen(0),
+      _rxLen(0), _rxPos(0), _failNext(0), _shortNext(0) {}
+
+void TwoWire::attach(HostI2CDevice *device) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_deviceCount < HOST_I2C_MAX_DEVICES)
+    _devices[_deviceCount++] = device;
+}
+
+void TwoWire::detachAll(void) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _deviceCount = 0;
+}
+
+void TwoWire::resetCounters(void) {
+  begins = 0;
+  transactions = 0;
+  bytes = 0;
+  nacks = 0;
+  collisions = 0;
+}
+
+HostI2CDevice *TwoWire::find(uint8_t addr) {
+  for (uint8_t i = 0; i < _deviceCount; i++) {
+    HostI2CDevice *device = _devices[i]->find(addr);
+    if (device)
+      return device;
+  }
+  return NULL;
+}
+
+void TwoWire::beginTransmission(uint8_t addr) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _txThread = std::this_thread::get_id();
+  _txAddr = addr;
+  _txLen = 0;
+}
+
+size_t TwoWire::write(uint8_t value) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_txThread != std::this_thread::get_id())
+    collisions++;
+  if (_txLen >= HOST_I2C_BUFFER)
+    return 0;
+  _tx[_txLen++] = value;
+  return 1;
+}
+
+uint8_t TwoWire::endTransmission(bool stop) {
+  (void)stop;
+  uint8_t len, status;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    transactions++;
+    if (_txThread != std::this_thread::get_id())
+      collisions++;
+    len = _txLen;
+    bytes += 1 + len;
+
+    HostI2CDevice *device = find(_txAddr);
+    if (_failNext) {
+      _failNext--;
+      status = 2;
+    } else if (!device) {
+      status = 2;
+    } else {
+      status = device->i2cWrite(_tx, _txLen) ? 0 : 3;
+    }
+    if (status)
+      nacks++;
+  }
+  hostBusTime((1 + len) * byteTimeUs);
+  return status;
+}
+
+uint8_t TwoWire::requestFrom(uint8_t addr, uint8_t len) {
+  uint8_t got = 0;
+  if (len > HOST_I2C_BUFFER)
+    len = HOST_I2C_BUFFER;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    transactions++;
+    _rxThread = std::this_thread::get_id();
+
+    HostI2CDevice *device = find(addr);
+    if (_failNext) {
+      _failNext--;
+    } else if (device) {
+      got = device->i2cRead(_rx, len);
+      if (_shortNext && got) {
+        _shortNext--;
+        got--;
+      }
+    }
+    if (!got)
+      nacks++;
+    _rxLen = got;
+    _rxPos = 0;
+    bytes += 1 + got;
+  }
+  hostBusTime((1 + got) * byteTimeUs);
+  return got;
+}
+
+int TwoWire::read(void) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_rxThread != std::this_thread::get_id())
+    collisions++;
+  return (_rxPos < _rxLen) ? _rx[_rxPos++] : -1;
+}
+
+int TwoWire::available(void) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _rxLen - _rxPos;
+}
@@ -0,0 +1,55 @@
+#include <Wire.h>
+#include <Adafruit_TSL2561_U.h>
+
+/* Takes one reading a second with whatever the build profile leaves in,
+   for size_report.sh to measure. Built with TSL2561_SIZE_BASELINE it does
+   the same Wire and Serial work without the driver, so the difference is
+   what the driver costs. TSL2561_SIZE_TEMPLATE measures
+   Adafruit_TSL2561_Fixed instead of Adafruit_TSL2561_Unified. */
+
+#if defined(TSL2561_SIZE_TEMPLATE)
+Adafruit_TSL2561_Fixed<TSL2561_ADDR_FLOAT, TSL2561_INTEGRATIONTIME_101MS,
+                       TSL2561_GAIN_1X>
+    tsl;
+#elif !defined(TSL2561_SIZE_BASELINE)
+Adafruit_TSL2561_Unified tsl(TSL2561_ADDR_FLOAT, 12345);
+#endif
+
+void setup(void) {
+  Serial.begin(9600);
+#ifdef TSL2561_SIZE_BASELINE
+  Wire.begin();
+#else
+  if (!tsl.begin(&Wire))
+    Serial.println("no TSL2561");
+#endif
+}
+
+void loop(void) {
+  uint16_t broadband = 0, ir = 0;
+
+#ifdef TSL2561_SIZE_BASELINE
+  Wire.requestFrom(TSL2561_ADDR_FLOAT, 4);
+  while (Wire.available())
+    broadband += Wire.read();
+#else
+  tsl.getLuminosity(&broadband, &ir);
+#endif
+  Serial.println(broadband);
+  Serial.println(ir);
+
+#if !defined(TSL2561_SIZE_BASELINE) && defined(TSL2561_WITH_LUX)
+#if defined(TSL2561_SIZE_TEMPLATE)
+  uint32_t lux;
+  if (tsl.getLux(&lux))
+    Serial.println(lux);
+#elif !defined(TSL2561_NO_UNIFIED_SENSOR)
+  sensors_event_t event;
+  if (tsl.getEvent(&event))
+    Serial.println(event.light);
+#else
+  Serial.println(tsl.calculateLux(broadband, ir));
+#endif
+#endif
+  delay(1000);
+}
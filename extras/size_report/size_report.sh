@@ -0,0 +1,140 @@
+#!/usr/bin/env bash
+#
+# Builds size_report.ino once per build profile and board with arduino-cli,
+# and prints the .text/.data/.bss of each, with .text and .data relative to
+# the same sketch without the driver.
+#
+#   extras/size_report/size_report.sh [--record] [fqbn...]
+#
+# Boards default to an AVR (Uno) and an ARM Cortex-M0+ (Zero). Their cores
+# and the Adafruit Unified Sensor library are installed if missing.
+#
+# What the driver adds to each section, over the sketch without it, is held
+# to the limits in thresholds.txt. The script fails if any profile grows
+# past its limit or has none recorded for the board. --record writes the
+# sizes measured instead, for a change that grows the driver on purpose.
+
+set -euo pipefail
+
+HERE="$(cd "$(dirname "$0")" && pwd)"
+LIBRARY="$(cd "$HERE/../.." && pwd)"
+THRESHOLDS="$HERE/thresholds.txt"
+RECORD=0
+if [ "${1:-}" = "--record" ]; then
+  RECORD=1
+  shift
+fi
+BOARDS=("$@")
+if [ ${#BOARDS[@]} -eq 0 ]; then
+  BOARDS=(arduino:avr:uno arduino:samd:arduino_zero_native)
+fi
+
+# name|build flags
+PROFILES=(
+  "baseline (no driver)|-DTSL2561_SIZE_BASELINE"
+  "default|"
+  "NO_AGC|-DTSL2561_NO_AGC"
+  "NO_UNIFIED_SENSOR|-DTSL2561_NO_UNIFIED_SENSOR"
+  "HEALTH_CHECK|-DTSL2561_HEALTH_CHECK"
+  "FIXED time+gain|-DTSL2561_FIXED_INTEGRATIONTIME=TSL2561_INTEGRATIONTIME_101MS -DTSL2561_FIXED_GAIN=TSL2561_GAIN_1X"
+  "PACKAGE_CS|-DTSL2561_PACKAGE_CS"
+  "RAW_ONLY|-DTSL2561_RAW_ONLY"
+  "RAW_ONLY minimal|-DTSL2561_RAW_ONLY -DTSL2561_NO_AGC -DTSL2561_FIXED_ADDR=TSL2561_ADDR_FLOAT"
+  "Fixed<> template|-DTSL2561_SIZE_TEMPLATE -DTSL2561_NO_UNIFIED_SENSOR"
+)
+
+DATA_DIR="$(arduino-cli config dump --format json |
+  python3 -c 'import json,sys; print(json.load(sys.stdin)["directories"]["data"])' \
+  2>/dev/null || echo "$HOME/.arduino15")"
+WORK="$(mktemp -d)"
+trap 'rm -rf "$WORK"' EXIT
+RECORDED="$WORK/thresholds"
+over=0
+
+# Limit "text data bss" recorded for a board and profile, or nothing
+limit() {
+  awk -F'|' -v fqbn="$1" -v name="$2" \
+    '$1 == fqbn && $2 == name { print $3, $4, $5 }' "$THRESHOLDS"
+}
+
+arduino-cli lib list 2>/dev/null | grep -q "^Adafruit_Unified_Sensor\|^Adafruit Unified Sensor" ||
+  arduino-cli lib install "Adafruit Unified Sensor" >/dev/null
+
+for fqbn in "${BOARDS[@]}"; do
+  core="${fqbn%:*}"
+  arduino-cli core list | grep -q "^$core " || arduino-cli core install "$core" >/dev/null
+
+  # The size tool that comes with the board's compiler
+  case "$core" in
+  *:avr) tool=avr-size ;;
+  *) tool=arm-none-eabi-size ;;
+  esac
+  size="$(find "$DATA_DIR/packages" -type f -name "$tool" | sort | tail -1)"
+  if [ -z "$size" ]; then
+    echo "$fqbn: $tool not found under $DATA_DIR/packages" >&2
+    exit 1
+  fi
+
+  echo "== $fqbn"
+  printf "%-22s %8s %8s %8s %10s %10s %10s\n" profile .text .data .bss \
+    "+.text" "+.data" "+.bss"
+  base_text=0
+  base_data=0
+  base_bss=0
+  for profile in "${PROFILES[@]}"; do
+    name="${profile%%|*}"
+    flags="${profile#*|}"
+    build="$WORK/$(echo "$fqbn $name" | tr -c 'a-zA-Z0-9\n' _)"
+    if ! arduino-cli compile --fqbn "$fqbn" --library "$LIBRARY" \
+      --build-path "$build" \
+      --build-property "compiler.cpp.extra_flags=$flags" \
+      "$HERE" >"$build.log" 2>&1; then
+      printf "%-22s build failed:\n" "$name"
+      sed 's/^/    /' "$build.log" | tail -20
+      exit 1
+    fi
+    read -r text data bss _ < <("$size" "$build/size_report.ino.elf" | tail -1)
+    if [ "$name" = "${PROFILES[0]%%|*}" ]; then
+      base_text=$text
+      base_data=$data
+      base_bss=$bss
+    fi
+    added=($((text - base_text)) $((data - base_data)) $((bss - base_bss)))
+    printf "%-22s %8u %8u %8u %+10d %+10d %+10d\n" "$name" "$text" "$data" \
+      "$bss" "${added[@]}"
+    [ "$name" = "${PROFILES[0]%%|*}" ] && continue
+
+    echo "$fqbn|$name|${added[0]}|${added[1]}|${added[2]}" >>"$RECORDED"
+    [ $RECORD -eq 1 ] && continue
+    read -r -a allowed < <(limit "$fqbn" "$name") || true
+    if [ ${#allowed[@]} -ne 3 ]; then
+      printf "%-22s no threshold recorded for %s\n" "" "$fqbn"
+      over=1
+      continue
+    fi
+    for i in 0 1 2; do
+      if [ "${added[$i]}" -gt "${allowed[$i]}" ]; then
+        section=(.text .data .bss)
+        printf "%-22s %s is %d bytes over its threshold of +%d\n" "" \
+          "${section[$i]}" $((added[i] - allowed[i])) "${allowed[$i]}"
+        over=1
+      fi
+    done
+  done
+done
+
+if [ $RECORD -eq 1 ]; then
+  # Keep the header and the boards that weren't measured
+  {
+    grep '^#' "$THRESHOLDS" || true
+    awk -F'|' -v boards=" ${BOARDS[*]} " \
+      '!/^#/ && NF && !index(boards, " " $1 " ")' "$THRESHOLDS"
+    cat "$RECORDED"
+  } >"$WORK/new"
+  cp "$WORK/new" "$THRESHOLDS"
+  echo "recorded in $THRESHOLDS"
+elif [ $over -ne 0 ]; then
+  echo "sizes over or missing from thresholds.txt; if intended, rerun with" \
+    "--record and commit the file" >&2
+  exit 1
+fi